@@ -4,6 +4,8 @@
 // Copyright 2025 Martin Povišer <povik@cutebit.org>
 // Distributed under the terms of the ISC license, see LICENSE
 //
+#include "slang/ast/expressions/ConversionExpression.h"
+#include "slang/ast/expressions/OperatorExpressions.h"
 #include "slang/ast/expressions/SelectExpressions.h"
 #include "slang/ast/types/Type.h"
 
@@ -13,6 +15,108 @@
 
 namespace slang_frontend {
 
+// Past this width we don't bother tracking bounds
+static const int max_tracked_width = 48;
+static const IndexRange unbounded = {-(int64_t(1) << max_tracked_width),
+		int64_t(1) << max_tracked_width};
+
+IndexRange signal_range(const RTLIL::SigSpec &signal)
+{
+	if (signal.size() > max_tracked_width)
+		return unbounded;
+
+	if (signal.empty())
+		return {0, 0};
+
+	IndexRange range = {0, 0};
+	for (int i = 0; i < signal.size(); i++) {
+		// the sign bit carries a negative weight
+		int64_t weight = int64_t(1) << i;
+		if (i == signal.size() - 1)
+			weight = -weight;
+
+		if (signal[i] == RTLIL::S1) {
+			range.min += weight;
+			range.max += weight;
+		} else if (signal[i] != RTLIL::S0) {
+			(weight > 0 ? range.max : range.min) += weight;
+		}
+	}
+	return range;
+}
+
+static std::optional<IndexRange> type_range(const ast::Type &type)
+{
+	if (!type.isIntegral() || (int)type.getBitWidth() >= max_tracked_width)
+		return {};
+
+	int width = type.getBitWidth();
+	if (type.isSigned())
+		return IndexRange{-(int64_t(1) << (width - 1)), (int64_t(1) << (width - 1)) - 1};
+	else
+		return IndexRange{0, (int64_t(1) << width) - 1};
+}
+
+std::optional<IndexRange> expression_range(const ast::Expression &expr)
+{
+	if (!expr.type || !expr.type->isIntegral())
+		return {};
+
+	if (expr.constant && expr.constant->isInteger()) {
+		auto value = expr.constant->integer().as<int64_t>();
+		if (value && std::abs(*value) < (int64_t(1) << max_tracked_width))
+			return IndexRange{*value, *value};
+	}
+
+	std::optional<IndexRange> bounds = type_range(*expr.type);
+	if (!bounds)
+		return {};
+
+	switch (expr.kind) {
+	case ast::ExpressionKind::Conversion: {
+		// As long as the operand fits into the target type, a conversion
+		// preserves the value
+		auto &conv = expr.as<ast::ConversionExpression>();
+		auto inner = expression_range(conv.operand());
+		if (inner && inner->min >= bounds->min && inner->max <= bounds->max)
+			return inner;
+	} break;
+	case ast::ExpressionKind::BinaryOp: {
+		auto &biop = expr.as<ast::BinaryExpression>();
+		auto lhs = expression_range(biop.left());
+		auto rhs = expression_range(biop.right());
+		if (!lhs || !rhs)
+			break;
+
+		switch (biop.op) {
+		case ast::BinaryOperator::BinaryAnd:
+			// masking by a nonnegative number bounds the result by that number
+			if (lhs->min >= 0 && rhs->min >= 0)
+				return IndexRange{0, std::min(lhs->max, rhs->max)};
+			if (lhs->min >= 0)
+				return IndexRange{0, lhs->max};
+			if (rhs->min >= 0)
+				return IndexRange{0, rhs->max};
+			break;
+		case ast::BinaryOperator::Mod:
+			if (rhs->min == rhs->max && rhs->min != 0) {
+				int64_t limit = std::abs(rhs->min) - 1;
+				if (lhs->min >= 0)
+					return IndexRange{0, std::min(limit, lhs->max)};
+				return IndexRange{-limit, limit}.intersect(*bounds);
+			}
+			break;
+		default:
+			break;
+		}
+	} break;
+	default:
+		break;
+	}
+
+	return bounds;
+}
+
 template <> RTLIL::SigSpec Addressing<RTLIL::SigSpec>::extract(RTLIL::SigSpec val, int width)
 {
 	using Signal = RTLIL::SigSpec;
@@ -11,6 +11,25 @@
 
 namespace slang_frontend {
 
+// Inclusive bounds on the value of an index signal
+struct IndexRange
+{
+	int64_t min, max;
+
+	IndexRange intersect(IndexRange other) const
+	{
+		return {std::max(min, other.min), std::min(max, other.max)};
+	}
+};
+
+// Bounds on `signal` interpreted as a signed number, as implied by its width
+// and its constant bits
+IndexRange signal_range(const RTLIL::SigSpec &signal);
+
+// Bounds on the value of an integral expression which we can infer
+// from its structure, if any
+std::optional<IndexRange> expression_range(const ast::Expression &expr);
+
 // TODO: audit for overflows
 template <typename Signal> struct Addressing
 {
@@ -32,27 +51,54 @@ template <typename Signal> struct Addressing
 
 	int stride = 1;
 
-	void interpret_index(IndexSignal signal, int width_down = 1, int width_up = 1)
+	// bounds on `raw_signal` as a signed number; where those bounds prove
+	// the index in range we skip building the validity checks
+	IndexRange raw_range = {0, 0};
+
+	void interpret_index(const ast::Expression &index, int width_down = 1, int width_up = 1)
 	{
+		IndexSignal signal = eval.eval_signed(index);
+		IndexRange index_range = signal_range(signal);
+		if (auto refined = expression_range(index))
+			index_range = index_range.intersect(*refined);
+
 		if (range.isLittleEndian()) {
 			base_offset = -range.right - width_down + 1;
 			raw_signal = signal;
+			raw_range = index_range;
 		} else {
 			base_offset = range.right - width_up + 1;
 
 			// We might want some other handling of big-endian
 			// indexing.
 			raw_signal = netlist.Not(signal);
+			raw_range = {-index_range.max - 1, -index_range.min - 1};
 			base_offset += 1;
 		}
 	}
 
+	// `raw_signal >= bound` unless we know it to hold
+	IndexSignal raw_ge(int64_t bound, IndexSignal bound_signal)
+	{
+		if (raw_range.min >= bound)
+			return {S1};
+		return netlist.Ge(raw_signal, bound_signal, true);
+	}
+
+	// `raw_signal < bound` unless we know it to hold
+	IndexSignal raw_lt(int64_t bound, IndexSignal bound_signal)
+	{
+		if (raw_range.max < bound)
+			return {S1};
+		return netlist.Lt(raw_signal, bound_signal, true);
+	}
+
 	Addressing(EvalContext &eval, const ast::ElementSelectExpression &sel)
 		: expr(sel), eval(eval), netlist(eval.netlist)
 	{
 		require(sel, sel.value().type->hasFixedRange());
 		range = sel.value().type->getFixedRange();
-		interpret_index(eval.eval_signed(sel.selector()));
+		interpret_index(sel.selector());
 
 		stride = sel.type->getBitstreamWidth();
 	}
@@ -75,16 +121,14 @@ template <typename Signal> struct Addressing
 				base_offset = range.right - rv.integer().as<int>().value();
 		} break;
 		case ast::RangeSelectionKind::IndexedUp: {
-			IndexSignal signal = eval.eval_signed(sel.left());
 			auto rv = sel.right().eval(eval.const_);
 			ast_invariant(sel, rv.isInteger());
-			interpret_index(signal, 1, rv.integer().as<int>().value());
+			interpret_index(sel.left(), 1, rv.integer().as<int>().value());
 		} break;
 		case ast::RangeSelectionKind::IndexedDown: {
-			IndexSignal signal = eval.eval_signed(sel.left());
 			auto rv = sel.right().eval(eval.const_);
 			ast_invariant(sel, rv.isInteger());
-			interpret_index(signal, rv.integer().as<int>().value(), 1);
+			interpret_index(sel.left(), rv.integer().as<int>().value(), 1);
 		} break;
 		}
 
@@ -149,7 +193,10 @@ template <typename Signal> struct Addressing
 		log_assert(val.size() == stride);
 		Signal negative, positive;
 
-		if (from < 0) {
+		if (from < 0 && raw_range.min >= 0) {
+			// The index can't be negative
+			negative = Signal(S0, -from * stride);
+		} else if (from < 0) {
 			// Build the negative branch
 			int demux_size = std::bit_ceil((unsigned int)-from);
 			int sel_size = ceil_log2(demux_size);
@@ -159,9 +206,9 @@ template <typename Signal> struct Addressing
 
 			// check `raw_signal` is in between -2**sel_size...0
 			// which is where the demuxing is valid
-			Signal valid =
-					netlist.LogicAnd(netlist.Ge(raw_signal, {S1, Signal(S0, sel_size)}, true),
-							netlist.Lt(raw_signal, {S0}, true));
+			Signal valid = netlist.LogicAnd(
+					raw_ge(-(int64_t(1) << sel_size), {S1, Signal(S0, sel_size)}),
+					raw_lt(0, {S0}));
 
 			Signal val_gated = netlist.Mux(Signal(S0, stride), val, valid);
 
@@ -170,7 +217,10 @@ template <typename Signal> struct Addressing
 			log_assert(negative.size() == -from * stride);
 		}
 
-		if (to > 0) {
+		if (to > 0 && raw_range.max < 0) {
+			// The index can't be nonnegative
+			positive = Signal(S0, to * stride);
+		} else if (to > 0) {
 			// Build the nonnegative branch
 			int demux_size = std::bit_ceil((unsigned int)to);
 			int sel_size = ceil_log2(demux_size);
@@ -180,13 +230,11 @@ template <typename Signal> struct Addressing
 
 			// check `raw_signal` is in between 0...2**sel_size
 			// which is where the demuxing is valid
-			Signal valid = netlist.LogicAnd(netlist.Ge(raw_signal, {S0}, true),
-					netlist.Lt(raw_signal, {S0, S1, Signal(S0, sel_size)}, true));
+			Signal valid = netlist.LogicAnd(raw_ge(0, {S0}),
+					raw_lt(int64_t(1) << sel_size, {S0, S1, Signal(S0, sel_size)}));
 
 			Signal val_gated = netlist.Mux(Signal(S0, stride), val, valid);
 
-			Signal demux_result = netlist.Demux(val_gated, sel);
-
 			positive = netlist.Demux(val_gated, sel).extract(0, to * stride);
 			log_assert(positive.size() == to * stride);
 		}
@@ -219,7 +267,7 @@ template <typename Signal> struct Addressing
 
 			Signal sel = raw_signal;
 			sel.extend_u0(sel_size, true);
-			Signal valid = netlist.Ge(raw_signal, {S1, Signal(S0, sel_size)}, true);
+			Signal valid = raw_ge(-(int64_t(1) << sel_size), {S1, Signal(S0, sel_size)});
 			negative = netlist.Mux(Signal(Sx, stride), netlist.Bmux(val_padded, sel), valid);
 		}
 
@@ -233,11 +281,15 @@ template <typename Signal> struct Addressing
 
 			Signal sel = raw_signal;
 			sel.extend_u0(sel_size, true);
-			Signal valid = netlist.Lt(raw_signal, {S0, S1, Signal(S0, sel_size)}, true);
+			Signal valid = raw_lt(int64_t(1) << sel_size, {S0, S1, Signal(S0, sel_size)});
 
 			positive = netlist.Mux(Signal(Sx, stride), netlist.Bmux(val_padded, sel), valid);
 		}
 
+		if (raw_range.min >= 0)
+			return positive;
+		if (raw_range.max < 0)
+			return negative;
 		return netlist.Mux(positive, negative, raw_signal.msb());
 	}
 
@@ -0,0 +1,117 @@
+//
+// Yosys slang frontend
+//
+// Copyright 2024 Martin Povišer <povik@cutebit.org>
+// Distributed under the terms of the ISC license, see LICENSE
+//
+#include <fstream>
+
+#include "slang/text/Json.h"
+
+#include "kernel/rtlil.h"
+
+#include "slang_frontend.h"
+
+namespace slang_frontend {
+
+void BlameReport::account(RTLIL::Module *mod, std::string_view module_name)
+{
+	Stats &module_stats = by_module[std::string(module_name)];
+
+	for (auto cell : mod->cells()) {
+		int bits = 0;
+		for (auto &[port, sig] : cell->connections()) {
+			if (cell->output(port))
+				bits += sig.size();
+		}
+
+		for (Stats *stats : {&by_source[cell->get_src_attribute()], &module_stats}) {
+			stats->cells++;
+			stats->cell_bits += bits;
+		}
+	}
+
+	for (auto wire : mod->wires()) {
+		for (Stats *stats : {&by_source[wire->get_src_attribute()], &module_stats}) {
+			stats->wires++;
+			stats->wire_bits += wire->width;
+		}
+	}
+}
+
+static std::vector<std::pair<std::string, BlameReport::Stats>> sorted_stats(
+		const Yosys::dict<std::string, BlameReport::Stats> &dict)
+{
+	std::vector<std::pair<std::string, BlameReport::Stats>> ret(dict.begin(), dict.end());
+	std::sort(ret.begin(), ret.end(), [](auto &a, auto &b) {
+		if (a.second.cell_bits != b.second.cell_bits)
+			return a.second.cell_bits > b.second.cell_bits;
+		if (a.second.cells != b.second.cells)
+			return a.second.cells > b.second.cells;
+		return a.first < b.first;
+	});
+	return ret;
+}
+
+void BlameReport::write(const std::string &filename)
+{
+	std::ofstream f(filename);
+	if (f.fail())
+		log_error("Can't open blame report file `%s' for writing\n", filename.c_str());
+
+	auto by_source_sorted = sorted_stats(by_source);
+	auto by_module_sorted = sorted_stats(by_module);
+
+	if (filename.size() >= 5 && filename.substr(filename.size() - 5) == ".json") {
+		slang::JsonWriter writer;
+		writer.setPrettyPrint(true);
+
+		auto write_table = [&](std::string_view name, std::string_view key,
+								const std::vector<std::pair<std::string, Stats>> &table) {
+			writer.writeProperty(name);
+			writer.startArray();
+			for (auto &[label, stats] : table) {
+				writer.startObject();
+				writer.writeProperty(key);
+				writer.writeValue(label);
+				writer.writeProperty("cells");
+				writer.writeValue(stats.cells);
+				writer.writeProperty("cell_bits");
+				writer.writeValue(stats.cell_bits);
+				writer.writeProperty("wires");
+				writer.writeValue(stats.wires);
+				writer.writeProperty("wire_bits");
+				writer.writeValue(stats.wire_bits);
+				writer.endObject();
+			}
+			writer.endArray();
+		};
+
+		writer.startObject();
+		write_table("sources", "src", by_source_sorted);
+		write_table("modules", "module", by_module_sorted);
+		writer.endObject();
+		f << writer.view() << std::endl;
+	} else {
+		auto write_table = [&](const char *key,
+								const std::vector<std::pair<std::string, Stats>> &table) {
+			f << Yosys::stringf("%10s %10s %10s %10s  %s\n", "cells", "cell bits", "wires",
+								"wire bits", key);
+			for (auto &[label, stats] : table) {
+				f << Yosys::stringf("%10lld %10lld %10lld %10lld  %s\n", (long long) stats.cells,
+									(long long) stats.cell_bits, (long long) stats.wires,
+									(long long) stats.wire_bits,
+									label.empty() ? "<no source>" : label.c_str());
+			}
+		};
+
+		write_table("source", by_source_sorted);
+		f << "\n";
+		write_table("module", by_module_sorted);
+	}
+
+	log("Wrote blame report for %d sources and %d modules to `%s'.\n",
+		GetSize(by_source), GetSize(by_module), filename.c_str());
+}
+
+}; // namespace slang_frontend
@@ -4,6 +4,9 @@
 // Copyright 2024 Martin Povišer <povik@cutebit.org>
 // Distributed under the terms of the ISC license, see LICENSE
 //
+// for the inline definition of ceil_log2, see procedural.cc
+#include "kernel/utils.h"
+
 #include "slang_frontend.h"
 #include "variables.h"
 
@@ -434,7 +437,7 @@ SigSpec RTLILBuilder::Unop(IdString op, SigSpec a, bool a_signed, int y_width)
 
 // Synthesizes two single-edge FFs (one posedge, one negedge) with the same D input,
 // then uses a mux controlled by the clock to select the appropriate FF output.
-void RTLILBuilder::add_dual_edge_aldff(const std::string &base_name, RTLIL::SigSpec clk,
+std::pair<RTLIL::Cell *, RTLIL::Cell *> RTLILBuilder::add_dual_edge_aldff(const std::string &base_name, RTLIL::SigSpec clk,
 		RTLIL::SigSpec aload, RTLIL::SigSpec d, RTLIL::SigSpec q, RTLIL::SigSpec ad,
 		bool aload_polarity)
 {
@@ -444,25 +447,26 @@ void RTLILBuilder::add_dual_edge_aldff(const std::string &base_name, RTLIL::SigS
 	RTLIL::Wire *neg_q = canvas->addWire(
 			canvas->uniquify(Yosys::stringf("%s$neg$q", base_name.c_str())), d.size());
 
+	RTLIL::Cell *pos_ff, *neg_ff;
 	if (aload.is_fully_def() && aload.size() == 1 && aload.as_bool() != aload_polarity) {
-		RTLIL::Cell *pos_ff =
+		pos_ff =
 				canvas->addDff(canvas->uniquify(Yosys::stringf("%s$pos", base_name.c_str())), clk,
 						d, pos_q, /*edge_polarity=*/true);
 		bless_cell(pos_ff);
 
 		// Create negedge FF
-		RTLIL::Cell *neg_ff =
+		neg_ff =
 				canvas->addDff(canvas->uniquify(Yosys::stringf("%s$neg", base_name.c_str())), clk,
 						d, neg_q, /*edge_polarity=*/false);
 		bless_cell(neg_ff);
 	} else {
-		RTLIL::Cell *pos_ff =
+		pos_ff =
 				canvas->addAldff(canvas->uniquify(Yosys::stringf("%s$pos", base_name.c_str())), clk,
 						aload, d, pos_q, ad,
 						/*clk_polarity=*/true, aload_polarity);
 		bless_cell(pos_ff);
 
-		RTLIL::Cell *neg_ff =
+		neg_ff =
 				canvas->addAldff(canvas->uniquify(Yosys::stringf("%s$neg", base_name.c_str())), clk,
 						aload, d, neg_q, ad,
 						/*clk_polarity=*/false, aload_polarity);
@@ -474,68 +478,115 @@ void RTLILBuilder::add_dual_edge_aldff(const std::string &base_name, RTLIL::SigS
 	RTLIL::Cell *mux = canvas->addMux(canvas->uniquify(Yosys::stringf("%s$mux", base_name.c_str())),
 			/*A=*/neg_q, /*B=*/pos_q, /*S=*/clk, /*Y=*/q);
 	bless_cell(mux);
+	return {pos_ff, neg_ff};
 }
 
-void RTLILBuilder::add_dff(RTLIL::IdString name, const RTLIL::SigSpec &clk, const RTLIL::SigSpec &d,
+RTLIL::Cell *RTLILBuilder::add_dff(RTLIL::IdString name, const RTLIL::SigSpec &clk, const RTLIL::SigSpec &d,
 		const RTLIL::SigSpec &q, bool clk_polarity)
 {
 	RTLIL::Cell *cell = canvas->addDff(name, clk, d, q, clk_polarity);
 	bless_cell(cell);
+	return cell;
 }
 
-void RTLILBuilder::add_dffe(RTLIL::IdString name, const RTLIL::SigSpec &clk,
+RTLIL::Cell *RTLILBuilder::add_dffe(RTLIL::IdString name, const RTLIL::SigSpec &clk,
 		const RTLIL::SigSpec &en, const RTLIL::SigSpec &d, const RTLIL::SigSpec &q,
 		bool clk_polarity, bool en_polarity)
 {
 	RTLIL::Cell *cell = canvas->addDffe(name, clk, en, d, q, clk_polarity, en_polarity);
 	bless_cell(cell);
+	return cell;
 }
 
-void RTLILBuilder::add_aldff(RTLIL::IdString name, const RTLIL::SigSpec &clk,
+RTLIL::Cell *RTLILBuilder::add_aldff(RTLIL::IdString name, const RTLIL::SigSpec &clk,
 		const RTLIL::SigSpec &aload, const RTLIL::SigSpec &d, const RTLIL::SigSpec &q,
 		const RTLIL::SigSpec &ad, bool clk_polarity, bool aload_polarity)
 {
 	RTLIL::Cell *cell = canvas->addAldff(name, clk, aload, d, q, ad, clk_polarity, aload_polarity);
 	bless_cell(cell);
+	return cell;
 }
 
-SigSpec  RTLILBuilder::CountOnes(SigSpec sig, int result_width)
+SigSpec RTLILBuilder::CountOnes(SigSpec sig, int result_width)
 {
-	SigSpec ret;
-	int x= 1, y = 0;
-	auto width = sig.size();
-	if (width == 0) {
-		ret = RTLIL::Const(0, 1);
-	} else if (width == 1) {
-		// Single bit
-		ret = sig;
-	} else {
-		// Build tree of adders
-		std::vector<RTLIL::SigSpec> curr_level;
-		for (int i = 0; i < width; i++) {
-			RTLIL::SigSpec bit = sig[i];
-			bit.extend_u0(result_width);
-			curr_level.push_back(bit);
-		}
-
-		while (curr_level.size() > 1) {
-			std::vector<RTLIL::SigSpec> nxt_level;
-			for (size_t i = 0; i + 1 < curr_level.size(); i += 2) {
-				auto sum = Biop(ID($add), curr_level[i], curr_level[i+1], false, false, result_width);
-				if (sum.size() < result_width)
-					sum.extend_u0(result_width);
-				nxt_level.push_back(sum);
-			}
-			if (curr_level.size() % 2 == 1) {
-				nxt_level.push_back(curr_level.back());
-			}
-			curr_level = std::move(nxt_level);
+	// Sum up the bits in a tree of adders. Each adder is only as wide as the
+	// largest sum it can produce, so the widths grow from a single bit at the
+	// leaves up to the result width at the root.
+	std::vector<std::pair<SigSpec, int>> level; // (partial sum, its maximum)
+	int ones = 0;
+	for (auto bit : sig) {
+		if (bit == RTLIL::S1)
+			ones++;
+		else if (bit.wire)
+			level.emplace_back(bit, 1);
+	}
+	if (ones)
+		level.emplace_back(RTLIL::Const(ones, ceil_log2(ones + 1)), ones);
+
+	if (level.empty())
+		return RTLIL::Const(0, result_width);
+
+	while (level.size() > 1) {
+		std::vector<std::pair<SigSpec, int>> next_level;
+		for (size_t i = 0; i + 1 < level.size(); i += 2) {
+			int max = level[i].second + level[i + 1].second;
+			int width = std::min(ceil_log2(max + 1), result_width);
+			next_level.emplace_back(
+					Biop(ID($add), level[i].first, level[i + 1].first, false, false, width), max);
 		}
-		ret = curr_level[0];
+		if (level.size() % 2 == 1)
+			next_level.push_back(level.back());
+		level.swap(next_level);
 	}
-	// Extend to expected type width
+
+	SigSpec ret = level[0].first;
 	ret.extend_u0(result_width);
 	return ret;
 }
 
+SigSpec RTLILBuilder::OneHot(SigSpec sig, bool zero_allowed)
+{
+	auto or_ = [&](SigSpec a, SigSpec b) -> SigSpec {
+		if (a == RTLIL::S0)
+			return b;
+		if (b == RTLIL::S0)
+			return a;
+		return Biop(ID($or), a, b, false, false, 1);
+	};
+
+	auto and_ = [&](SigSpec a, SigSpec b) -> SigSpec {
+		if (a == RTLIL::S0 || b == RTLIL::S0)
+			return RTLIL::S0;
+		return Biop(ID($and), a, b, false, false, 1);
+	};
+
+	// For each subtree track whether any bit is set, and whether more
+	// than one bit is set
+	std::vector<std::pair<SigSpec, SigSpec>> level;
+	for (auto bit : sig)
+		level.emplace_back(bit, RTLIL::S0);
+
+	if (level.empty())
+		return zero_allowed ? RTLIL::S1 : RTLIL::S0;
+
+	while (level.size() > 1) {
+		std::vector<std::pair<SigSpec, SigSpec>> next_level;
+		for (size_t i = 0; i + 1 < level.size(); i += 2) {
+			auto &[any_a, multi_a] = level[i];
+			auto &[any_b, multi_b] = level[i + 1];
+			next_level.emplace_back(
+					or_(any_a, any_b), or_(or_(multi_a, multi_b), and_(any_a, any_b)));
+		}
+		if (level.size() % 2 == 1)
+			next_level.push_back(level.back());
+		level.swap(next_level);
+	}
+
+	auto [any, multi] = level[0];
+	if (zero_allowed)
+		return LogicNot(multi);
+	else
+		return LogicAnd(any, LogicNot(multi));
+}
+
 }; // namespace slang_frontend
@@ -56,8 +56,12 @@ struct Case
 		slang::SourceLocation loc;
 
 		VariableBits lvalue;
+		// Empty if all of the bits are assigned unconditionally
 		RTLIL::SigSpec mask;
 		RTLIL::SigSpec unmasked_rvalue;
+
+		bool unmasked() const { return mask.empty(); }
+		RTLIL::SigBit mask_bit(int i) const { return mask.empty() ? RTLIL::SigBit(RTLIL::S1) : mask[i]; }
 	};
 	std::vector<RTLIL::SigSpec> compare;
 	std::vector<Action> actions;
@@ -117,6 +121,28 @@ struct Case
 		return ret;
 	}
 
+	// Remove the parts of auxiliary actions which drive any of `bits`
+	void drop_aux_actions(const Yosys::pool<RTLIL::SigBit> &bits)
+	{
+		std::vector<RTLIL::SigSig> kept;
+		for (auto &action : aux_actions) {
+			RTLIL::SigSig part;
+			for (int i = 0; i < action.first.size(); i++) {
+				if (bits.count(action.first[i]))
+					continue;
+				part.first.append(action.first[i]);
+				part.second.append(action.second[i]);
+			}
+			if (!part.first.empty())
+				kept.push_back(part);
+		}
+		aux_actions.swap(kept);
+
+		for (auto switch_ : switches)
+			for (auto case_ : switch_->cases)
+				case_->drop_aux_actions(bits);
+	}
+
 	void insert_latch_signaling(
 			DiagnosticIssuer &issuer, Yosys::dict<VariableBit, RTLIL::SigSig> &map)
 	{
@@ -127,6 +153,8 @@ struct Case
 			bool raise_complex = false;
 			VariableBits lvalue;
 			RTLIL::SigSpec enables, lstaging, rvalue;
+			// bits may share an enable signal
+			Yosys::pool<RTLIL::SigBit> enables_seen;
 
 			for (int i = 0; i < (int)action.lvalue.size(); i++) {
 				VariableBit lbit = action.lvalue[i];
@@ -134,14 +162,16 @@ struct Case
 				if (map.count(lbit)) {
 					auto &mapped = map.at(lbit);
 
-					if (action.mask[i] == RTLIL::S1 && !has_mask_switches.count(lbit)) {
+					RTLIL::SigBit mask_bit = action.mask_bit(i);
+					if (mask_bit == RTLIL::S1 && !has_mask_switches.count(lbit)) {
 						lvalue.append(lbit);
 						lstaging.append(mapped.second);
-						enables.append(mapped.first);
+						if (enables_seen.insert(mapped.first).second)
+							enables.append(mapped.first);
 						rvalue.append(action.unmasked_rvalue[i]);
 					} else {
 						Switch *sw = new Switch;
-						sw->signal = action.mask[i];
+						sw->signal = mask_bit;
 						sw->level = level + 1;
 						sw->statement = statement;
 						prepended_switches.push_back(sw);
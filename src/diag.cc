@@ -116,6 +116,7 @@ DiagCode InlinedInOutUnsupported(DiagSubsystem::Netlist, 1062);
 DiagCode PastGatingClockingUnsupported(DiagSubsystem::Netlist, 1063);
 DiagCode SystemFunctionRequireClockedBlock(DiagSubsystem::Netlist, 1064);
 DiagCode UnsupportedBitConversion(DiagSubsystem::Netlist, 1065);
+DiagCode NoteModuleNotDissolvedBecauseReplicated(DiagSubsystem::Netlist, 1066);
 
 DiagGroup unsynthesizable("unsynthesizable",
 		{IffUnsupported, GenericTimingUnsyn, BothEdgesUnsupported, ExpectingIfElseAload,
@@ -260,6 +261,8 @@ void setup_messages(slang::DiagnosticEngine &engine)
 	engine.setSeverity(NoteModuleNotDissolvedBecauseBlackbox, DiagnosticSeverity::Note);
 	engine.setMessage(NoteModuleNotDissolvedBecauseKeepHierarchy, "instance of module '{}' will not dissolve because of '--keep-hierarchy' option");
 	engine.setSeverity(NoteModuleNotDissolvedBecauseKeepHierarchy, DiagnosticSeverity::Note);
+	engine.setMessage(NoteModuleNotDissolvedBecauseReplicated, "instance of module '{}' will not dissolve because the module is replicated enough to cross the '--auto-hierarchy' threshold");
+	engine.setSeverity(NoteModuleNotDissolvedBecauseReplicated, DiagnosticSeverity::Note);
 
 	engine.setMessage(BlockingAssignmentAfterNonblocking, "blocking assignment to variable '{}' is not supported after previous non-blocking assignment");
 	engine.setSeverity(BlockingAssignmentAfterNonblocking, DiagnosticSeverity::Error);
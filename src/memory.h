@@ -15,6 +15,12 @@ struct InferredMemoryDetector : public TimingPatternInterpretor,
 								public DiagnosticIssuer
 {
 	Yosys::pool<const ast::Symbol *> memory_candidates;
+
+	// Fewest number of unpacked dimensions selected by any access to a
+	// candidate; unpacked dimensions up to this number can be folded into
+	// the memory address
+	Yosys::dict<const ast::Symbol *, int> min_select_depth;
+
 	std::function<bool(const ast::InstanceSymbol &sym)> should_dissolve;
 	bool disallow_implicit = false;
 
@@ -120,15 +126,46 @@ struct InferredMemoryDetector : public TimingPatternInterpretor,
 		assign.right().visit(*this);
 	}
 
+	void note_select_depth(const ast::Symbol &symbol, int depth)
+	{
+		if (!min_select_depth.count(&symbol) || min_select_depth.at(&symbol) > depth)
+			min_select_depth[&symbol] = depth;
+	}
+
 	void handle(const ast::ElementSelectExpression &expr)
 	{
-		if (ast::ValueExpressionBase::isKind(expr.value().kind)) {
-			// do nothing
-		} else {
-			expr.value().visit(*this);
+		// Walk down the chain of element selects to see how many dimensions
+		// of a potential memory get selected
+		const ast::Expression *value = &expr;
+		int depth = 0;
+		while (value->kind == ast::ExpressionKind::ElementSelect) {
+			auto &sel = value->as<ast::ElementSelectExpression>();
+			sel.selector().visit(*this);
+			value = &sel.value();
+			depth++;
+		}
+
+		if (ast::ValueExpressionBase::isKind(value->kind))
+			note_select_depth(value->as<ast::ValueExpressionBase>().symbol, depth);
+		else
+			value->visit(*this);
+	}
+
+	// Number of unpacked dimensions we fold into the address of the given
+	// memory: all of the leading fixed-range unpacked dimensions as long as
+	// every access selects them all
+	int memory_dimensions(const ast::Symbol &symbol)
+	{
+		const ast::Type *type = &symbol.as<ast::ValueSymbol>().getType().getCanonicalType();
+		int dims = 0;
+		while (type->isUnpackedArray() && type->hasFixedRange()) {
+			dims++;
+			type = &type->getArrayElementType()->getCanonicalType();
 		}
 
-		expr.selector().visit(*this);
+		if (min_select_depth.count(&symbol))
+			dims = std::min(dims, min_select_depth.at(&symbol));
+		return std::max(dims, 1);
 	}
 
 	bool wr_allowed = false;
@@ -142,6 +179,8 @@ struct InferredMemoryDetector : public TimingPatternInterpretor,
 
 			const ast::Expression *raw_lexpr = &assign.left();
 			LHSVisitor fallback(*this);
+			// number of element selects directly above `raw_lexpr`
+			int depth = 0;
 			while (true) {
 				switch (raw_lexpr->kind) {
 				case ast::ExpressionKind::RangeSelect: {
@@ -149,19 +188,23 @@ struct InferredMemoryDetector : public TimingPatternInterpretor,
 					sel.left().visit(*this);
 					sel.right().visit(*this);
 					raw_lexpr = &sel.value();
+					depth = 0;
 				} break;
 				case ast::ExpressionKind::ElementSelect: {
 					auto &sel = raw_lexpr->as<ast::ElementSelectExpression>();
 					sel.selector().visit(*this);
 					raw_lexpr = &sel.value();
+					depth++;
 					if (ast::ValueExpressionBase::isKind(sel.value().kind)) {
 						// a potential memory candidate
+						note_select_depth(sel.value().as<ast::ValueExpressionBase>().symbol, depth);
 						return;
 					}
 				} break;
 				case ast::ExpressionKind::MemberAccess: {
 					const auto &acc = raw_lexpr->as<ast::MemberAccessExpression>();
 					raw_lexpr = &acc.value();
+					depth = 0;
 				} break;
 				default: raw_lexpr->visit(fallback); return;
 				}
@@ -107,7 +107,9 @@ ProceduralContext::ProceduralContext(NetlistContext &netlist, ProcessTiming &tim
 }
 
 ProceduralContext::~ProceduralContext()
-{}
+{
+	emit_masked_writes();
+}
 
 void ProceduralContext::inherit_state(ProceduralContext &other)
 {
@@ -119,6 +121,10 @@ void ProceduralContext::inherit_state(ProceduralContext &other)
 	seen_nonblocking_assignment = other.seen_nonblocking_assignment;
 	preceding_memwr = other.preceding_memwr;
 	vstate = other.vstate;
+	// the result wire of an open chain in `other` is now visible to us, so
+	// the chain needs to stay as it is
+	other.vstate.open_chain = nullptr;
+	vstate.open_chain = nullptr;
 	flag_counter = other.flag_counter;
 }
 
@@ -127,6 +133,20 @@ void ProceduralContext::copy_case_tree_into(RTLIL::CaseRule &rule)
 	root_case->copy_into(netlist, &rule);
 }
 
+void ProceduralContext::drop_merge_path(const Yosys::pool<VariableBit> &bits)
+{
+	Yosys::pool<RTLIL::SigBit> dropped;
+	for (auto &[wire_bit, var_bit] : vstate.merge_wires) {
+		// merged values of a variable with blocking assignments may have
+		// been read further down the process
+		if (bits.count(var_bit) && !seen_blocking_assignment.count(var_bit.variable))
+			dropped.insert(wire_bit);
+	}
+
+	if (!dropped.empty())
+		root_case->drop_aux_actions(dropped);
+}
+
 VariableBits ProceduralContext::all_driven()
 {
 	VariableBits all_driven;
@@ -152,31 +172,51 @@ RTLIL::SigBit ProceduralContext::case_enable()
 	return ret;
 }
 
-void crop_zero_mask(const RTLIL::SigSpec &mask, RTLIL::SigSpec &target)
+// Drops the bits disabled by `mask` from an assignment, in a single pass
+static void crop_zero_mask(RTLIL::SigSpec &mask, VariableBits &lvalue, RTLIL::SigSpec &rvalue)
 {
-	for (int i = mask.size() - 1; i >= 0; i--) {
-		if (mask[i] == RTLIL::S0)
-			target.remove(i, 1);
-	}
-}
+	bool has_zero = false;
+	for (auto &chunk : mask.chunks())
+		if (!chunk.wire && std::find(chunk.data.begin(), chunk.data.end(), RTLIL::S0) != chunk.data.end())
+			has_zero = true;
+	if (!has_zero)
+		return;
 
-void crop_zero_mask(const RTLIL::SigSpec &mask, VariableBits &target)
-{
-	for (int i = mask.size() - 1; i >= 0; i--) {
-		if (mask[i] == RTLIL::S0)
-			target.erase(target.begin() + i);
+	std::vector<RTLIL::SigBit> mask_bits = mask.to_sigbit_vector();
+	std::vector<RTLIL::SigBit> rvalue_bits = rvalue.to_sigbit_vector();
+
+	int j = 0;
+	for (int i = 0; i < (int)mask_bits.size(); i++) {
+		if (mask_bits[i] == RTLIL::S0)
+			continue;
+		mask_bits[j] = mask_bits[i];
+		rvalue_bits[j] = rvalue_bits[i];
+		lvalue[j] = lvalue[i];
+		j++;
 	}
+
+	if (j == (int)mask_bits.size())
+		return;
+
+	mask_bits.resize(j);
+	rvalue_bits.resize(j);
+	lvalue.resize(j);
+	mask = mask_bits;
+	rvalue = rvalue_bits;
 }
 
 void ProceduralContext::update_variable_state(slang::SourceLocation loc, VariableBits lvalue,
 		RTLIL::SigSpec unmasked_rvalue, RTLIL::SigSpec mask, bool blocking)
 {
 	log_assert((int)lvalue.size() == unmasked_rvalue.size());
-	log_assert((int)lvalue.size() == mask.size());
 
-	crop_zero_mask(mask, lvalue);
-	crop_zero_mask(mask, unmasked_rvalue);
-	crop_zero_mask(mask, mask);
+	if (!mask.empty()) {
+		log_assert((int)lvalue.size() == mask.size());
+		crop_zero_mask(mask, lvalue, unmasked_rvalue);
+		// represent a mask of all ones implicitly
+		if (mask.is_fully_ones())
+			mask = {};
+	}
 
 	for (auto chunk : lvalue.chunks()) {
 		if (chunk.variable.kind == Variable::Static) {
@@ -212,22 +252,77 @@ void ProceduralContext::update_variable_state(slang::SourceLocation loc, Variabl
 
 	current_case->actions.push_back(Case::Action{loc, lvalue, mask, unmasked_rvalue});
 
-	if (mask.is_fully_ones()) {
+	if (mask.empty()) {
 		// shortcut path to support initialization of automatic variables
 		// (evaluating the background value is unavailable on the first
 		// assignment)
 		vstate.set(lvalue, unmasked_rvalue);
+	} else if (vstate.open_chain && !masked_writes.empty() &&
+			masked_writes.back().result == vstate.open_chain &&
+			masked_writes.back().lvalue == lvalue) {
+		// Nothing has observed the result of the preceding masked assignment
+		// to the same bits, fold this one into it
+		masked_writes.back().writes.emplace_back(unmasked_rvalue, mask);
 	} else {
 		RTLIL::SigSpec rvalue_background = vstate.evaluate(netlist, lvalue);
-		RTLIL::SigSpec rvalue = netlist.Bwmux(rvalue_background, unmasked_rvalue, mask);
-		vstate.set(lvalue, rvalue);
+		RTLIL::Wire *result = netlist.canvas->addWire(netlist.new_id(), lvalue.size());
+		masked_writes.push_back({lvalue, rvalue_background, {{unmasked_rvalue, mask}}, result});
+		vstate.set(lvalue, result);
+		vstate.open_chain = result;
 	}
 }
 
+void ProceduralContext::emit_masked_writes()
+{
+	for (auto &chain : masked_writes) {
+		int width = chain.lvalue.size();
+
+		// Reduce the chain pairwise, of two adjacent writes the later one taking
+		// precedence, with the background as the leading write. The merges on
+		// each level of the reduction are done side by side in a single $bwmux,
+		// and a single $or for the masks we still need, so the network stays
+		// within the cell count of a serial chain while being of logarithmic
+		// depth. The leading write never needs its mask.
+		std::vector<std::pair<RTLIL::SigSpec, RTLIL::SigSpec>> writes;
+		writes.emplace_back(chain.background, RTLIL::SigSpec());
+		writes.insert(writes.end(), chain.writes.begin(), chain.writes.end());
+
+		while (writes.size() > 1) {
+			RTLIL::SigSpec data1, data2, sel, mask1, mask2;
+			int npairs = writes.size() / 2;
+			for (int i = 0; i < npairs; i++) {
+				data1.append(writes[2 * i].first);
+				data2.append(writes[2 * i + 1].first);
+				sel.append(writes[2 * i + 1].second);
+				if (i > 0) {
+					mask1.append(writes[2 * i].second);
+					mask2.append(writes[2 * i + 1].second);
+				}
+			}
+
+			RTLIL::SigSpec data = netlist.Bwmux(data1, data2, sel);
+			RTLIL::SigSpec mask;
+			if (npairs > 1)
+				mask = netlist.Biop(ID($or), mask1, mask2, false, false, mask1.size());
+
+			std::vector<std::pair<RTLIL::SigSpec, RTLIL::SigSpec>> merged;
+			for (int i = 0; i < npairs; i++)
+				merged.emplace_back(data.extract(i * width, width),
+						i > 0 ? mask.extract((i - 1) * width, width) : RTLIL::SigSpec());
+			if (writes.size() % 2)
+				merged.push_back(writes.back());
+			writes.swap(merged);
+		}
+
+		netlist.canvas->connect(chain.result, writes.front().first);
+	}
+	masked_writes.clear();
+}
+
 void ProceduralContext::do_simple_assign(
 		slang::SourceLocation loc, VariableBits lvalue, RTLIL::SigSpec rvalue, bool blocking)
 {
-	update_variable_state(loc, lvalue, rvalue, RTLIL::SigSpec(RTLIL::S1, rvalue.size()), blocking);
+	update_variable_state(loc, lvalue, rvalue, {}, blocking);
 }
 
 RTLIL::SigSpec ProceduralContext::substitute_rvalue(VariableBits bits)
@@ -254,7 +349,8 @@ void ProceduralContext::assign_rvalue(
 
 	bool blocking = !assign.isNonBlocking();
 	const ast::Expression *raw_lexpr = &assign.left();
-	RTLIL::SigSpec raw_mask = RTLIL::SigSpec(RTLIL::S1, rvalue.size()), raw_rvalue = rvalue;
+	// empty for a mask of all ones
+	RTLIL::SigSpec raw_mask, raw_rvalue = rvalue;
 
 	if (raw_lexpr->kind == ast::ExpressionKind::Streaming) {
 		auto &stream_lexpr = raw_lexpr->as<ast::StreamingConcatenationExpression>();
@@ -296,9 +392,17 @@ void ProceduralContext::assign_rvalue_inner(const ast::AssignmentExpression &ass
 		const ast::Expression *raw_lexpr, RTLIL::SigSpec raw_rvalue, RTLIL::SigSpec raw_mask,
 		bool blocking)
 {
-	ast_invariant(assign, raw_mask.size() == (int)raw_lexpr->type->getBitstreamWidth());
+	ast_invariant(assign, raw_mask.empty() ||
+			raw_mask.size() == (int)raw_lexpr->type->getBitstreamWidth());
 	ast_invariant(assign, raw_rvalue.size() == (int)raw_lexpr->type->getBitstreamWidth());
 
+	// An empty `raw_mask` stands for all ones, we spell it out only once
+	// we need to shift or pad it
+	auto explicit_mask = [&]() {
+		if (raw_mask.empty())
+			raw_mask = RTLIL::SigSpec(RTLIL::S1, raw_rvalue.size());
+	};
+
 	bool finished_etching = false;
 	bool memory_write = false;
 	while (!finished_etching) {
@@ -307,6 +411,7 @@ void ProceduralContext::assign_rvalue_inner(const ast::AssignmentExpression &ass
 			auto &sel = raw_lexpr->as<ast::RangeSelectExpression>();
 			Addressing<RTLIL::SigSpec> addr(eval, sel);
 			int wider_size = sel.value().type->getBitstreamWidth();
+			explicit_mask();
 			raw_mask = addr.shift_up(raw_mask, false, wider_size);
 			raw_rvalue = addr.shift_up(raw_rvalue, true, wider_size);
 			raw_lexpr = &sel.value();
@@ -314,13 +419,14 @@ void ProceduralContext::assign_rvalue_inner(const ast::AssignmentExpression &ass
 		case ast::ExpressionKind::ElementSelect: {
 			auto &sel = raw_lexpr->as<ast::ElementSelectExpression>();
 
-			if (netlist.is_inferred_memory(sel.value())) {
+			if (netlist.memory_word_select(sel)) {
 				finished_etching = true;
 				memory_write = true;
 				break;
 			}
 
 			Addressing<RTLIL::SigSpec> addr(eval, sel);
+			explicit_mask();
 			raw_mask = addr.demux(raw_mask, sel.value().type->getBitstreamWidth());
 			raw_rvalue = raw_rvalue.repeat(addr.range.width());
 			raw_lexpr = &sel.value();
@@ -340,6 +446,7 @@ void ProceduralContext::assign_rvalue_inner(const ast::AssignmentExpression &ass
 			int bit_offset = bitstream_member_offset(member);
 			int parent_width = acc.value().type->getBitstreamWidth();
 			int pad = parent_width - acc.type->getBitstreamWidth() - bit_offset;
+			explicit_mask();
 			raw_mask = {RTLIL::SigSpec(RTLIL::S0, pad), raw_mask,
 					RTLIL::SigSpec(RTLIL::S0, bit_offset)};
 			raw_rvalue = {RTLIL::SigSpec(RTLIL::Sx, pad), raw_rvalue,
@@ -348,30 +455,32 @@ void ProceduralContext::assign_rvalue_inner(const ast::AssignmentExpression &ass
 		} break;
 		case ast::ExpressionKind::Concatenation: {
 			const auto &concat = raw_lexpr->as<ast::ConcatenationExpression>();
-			int base = raw_mask.size(), len;
+			int base = raw_rvalue.size(), len;
 			for (auto op : concat.operands()) {
 				require(concat, op->type->isBitstreamType());
 				base -= (len = op->type->getBitstreamWidth());
 				log_assert(base >= 0);
 				assign_rvalue_inner(assign, op, raw_rvalue.extract(base, len),
-						raw_mask.extract(base, len), blocking);
+						raw_mask.empty() ? RTLIL::SigSpec() : raw_mask.extract(base, len), blocking);
 			}
 			log_assert(base == 0);
 			return;
 		} break;
 		default: finished_etching = true; break;
 		}
-		log_assert(raw_mask.size() == (int)raw_lexpr->type->getBitstreamWidth());
+		log_assert(raw_mask.empty() || raw_mask.size() == (int)raw_lexpr->type->getBitstreamWidth());
 		log_assert(raw_rvalue.size() == (int)raw_lexpr->type->getBitstreamWidth());
 	}
 
 	if (memory_write) {
 		log_assert(raw_lexpr->kind == ast::ExpressionKind::ElementSelect);
 		auto &sel = raw_lexpr->as<ast::ElementSelectExpression>();
-		log_assert(netlist.is_inferred_memory(sel.value()));
+		auto memory = netlist.memory_word_select(sel);
+		log_assert(memory);
 		require(assign, !blocking);
+		explicit_mask();
 
-		RTLIL::IdString id = netlist.id(sel.value().as<ast::ValueExpressionBase>().symbol);
+		RTLIL::IdString id = netlist.id(*memory);
 		RTLIL::Cell *memwr = netlist.canvas->addCell(netlist.new_id(), ID($memwr_v2));
 		memwr->setParam(ID::MEMID, id.str());
 		if (timing.implicit()) {
@@ -395,10 +504,10 @@ void ProceduralContext::assign_rvalue_inner(const ast::AssignmentExpression &ass
 			}
 		}
 		memwr->setParam(ID::PRIORITY_MASK, mask);
+		RTLIL::SigSpec valid;
+		RTLIL::SigSpec addr = eval.memory_address(sel, &valid);
 		memwr->setPort(ID::EN, netlist.Mux(RTLIL::SigSpec(RTLIL::S0, raw_mask.size()), raw_mask,
-									   netlist.LogicAnd(case_enable(), timing.background_enable)));
-
-		RTLIL::SigSpec addr = eval(sel.selector());
+									   netlist.LogicAnd(netlist.LogicAnd(case_enable(), timing.background_enable), valid)));
 
 		memwr->setParam(ID::ABITS, addr.size());
 		memwr->setPort(ID::ADDR, addr);
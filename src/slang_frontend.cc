@@ -19,6 +19,7 @@
 #include "slang/text/Json.h"
 #include "slang/util/Util.h"
 
+#include "backends/rtlil/rtlil_backend.h"
 #include "kernel/bitpattern.h"
 #include "kernel/celltypes.h"
 #include "kernel/fmt.h"
@@ -47,6 +48,10 @@ void SynthesisSettings::addOptions(slang::CommandLine &cmdLine) {
 				"Keep hierarchy (experimental; may crash)");
 	cmdLine.add("--best-effort-hierarchy", best_effort_hierarchy,
 				"Keep hierarchy in a 'best effort' mode");
+	cmdLine.add("--auto-hierarchy", auto_hierarchy,
+				"Keep hierarchy for modules whose number of instances times the estimated size "
+				"of one instance (in AST nodes) reaches the given threshold, if the instances are "
+				"eligible for keeping under '--best-effort-hierarchy'", "<threshold>");
 	cmdLine.add("--ignore-timing", ignore_timing,
 				"Ignore delays for synthesis");
 	cmdLine.add("--ignore-initial", ignore_initial,
@@ -69,12 +74,46 @@ void SynthesisSettings::addOptions(slang::CommandLine &cmdLine) {
 				"Assume empty modules are blackboxes");
 	cmdLine.add("--ast-compilation-only", ast_compilation_only,
 				"For developers: stop after the AST is fully compiled");
+	cmdLine.add("--lint-only", lint_only,
+				"Run the netlist import for its diagnostics only, dropping the contents of each "
+				"module once it's imported; the design is left unchanged");
+	cmdLine.add("--max-netlist-errors", max_netlist_errors,
+				"Stop importing further modules once the given number of errors has been issued",
+				"<count>");
+	cmdLine.add("--emit", emit,
+				"Write the imported modules in RTLIL format to the given file one at a time as "
+				"they are finished, rather than adding them to the design", "<file>");
+	cmdLine.add("--blame-report", blame_report,
+				"Write a report of the number of cells, cell output bits and wires imported for "
+				"each source location and for each module; the report is in JSON if the filename "
+				"ends in '.json'", "<file>");
+	cmdLine.add("--sweep", sweep,
+				"Elaborate the design once for each of the listed values of a top-level parameter, "
+				"giving each point its own copy of the hierarchy with '$<name>=<value>' appended to "
+				"the module names; none of the points' top modules is marked as the design top",
+				"<name>=<value>,<value>...");
 	cmdLine.add("--no-default-translate-off-format", no_default_translate_off,
 				"Do not interpret any comment directives marking disabled input unless specified with '--translate-off-format'");
 	cmdLine.add("--allow-dual-edge-ff", allow_dual_edge_ff,
 				"Allow synthesis of dual-edge flip-flops (@(edge))");
 	cmdLine.add("--no-synthesis-define", no_synthesis_define,
 				"Don't add implicit -D SYNTHESIS");
+	cmdLine.add("--no-split-flops", no_split_flops,
+				"Emit a single flip-flop cell for each driven range of an aggregate variable, "
+				"rather than one for each struct field or array element; the names of the fields "
+				"are kept in the 'slang_fields' attribute on the cell");
+	cmdLine.add("--module-dedup", module_dedup,
+				"Merge emitted modules which are structurally identical, e.g. specializations "
+				"of the same module for different instance paths under --keep-hierarchy");
+	cmdLine.add("--no-netlist-check", no_netlist_check,
+				"Skip the internal consistency check of emitted modules");
+	cmdLine.add("--rom-threshold", rom_threshold_,
+				"Import a constant array indexed by a signal as a ROM if it holds at least "
+				"the given number of bits (default: 1024)", "<bits>");
+	cmdLine.add("--gate-netlist", gate_netlist,
+				"Speed up the import of gate-level netlists by leaving out the source locations "
+				"and hierarchical names (the 'src' and 'hdlname' attributes) on the cells for "
+				"primitive and unknown module instances; attributes given in the source are kept");
 	cmdLine.add("--blackboxed-module",
 				[this](std::string_view value) {
 					blackboxed_modules.insert(std::string(value));
@@ -168,7 +207,7 @@ static const RTLIL::IdString module_type_id(const ast::InstanceBodySymbol &sym)
 		return RTLIL::escape_id(std::string(sym.name) + "$" + instance);
 }
 
-static const RTLIL::Const convert_svint(const slang::SVInt &svint)
+static const RTLIL::Const convert_svint(const slang::SVInt &svint, bool *has_z=nullptr)
 {
 	std::vector<RTLIL::State> bits;
 	bits.reserve(svint.getBitWidth());
@@ -177,7 +216,11 @@ static const RTLIL::Const convert_svint(const slang::SVInt &svint)
 	case 0: bits.push_back(RTLIL::State::S0); break;
 	case 1: bits.push_back(RTLIL::State::S1); break;
 	case slang::logic_t::X_VALUE: bits.push_back(RTLIL::State::Sx); break;
-	case slang::logic_t::Z_VALUE: bits.push_back(RTLIL::State::Sz); break;
+	case slang::logic_t::Z_VALUE:
+		bits.push_back(RTLIL::State::Sz);
+		if (has_z)
+			*has_z = true;
+		break;
 	}
 	return bits;
 }
@@ -209,7 +252,7 @@ const std::optional<RTLIL::Const> NetlistContext::convert_const(const slang::Con
 	}
 
 	if (constval.isInteger()) {
-		return convert_svint(constval.integer());
+		return convert_svint(constval.integer(), &emitted_z);
 	} else if (constval.isUnpacked()) {
 		std::vector<RTLIL::State> bits;
 		bits.reserve(constval.getBitstreamWidth());
@@ -226,7 +269,7 @@ const std::optional<RTLIL::Const> NetlistContext::convert_const(const slang::Con
 		log_assert(bits.size() == constval.getBitstreamWidth());
 		return bits;
 	} else if (constval.isString()) {
-		RTLIL::Const ret = convert_svint(constval.convertToInt().integer());
+		RTLIL::Const ret = convert_svint(constval.convertToInt().integer(), &emitted_z);
 		ret.flags |= RTLIL::CONST_FLAG_STRING;
 		return ret;
 	} else if (constval.isNullHandle()) {
@@ -264,18 +307,24 @@ std::optional<RTLIL::Const> convert_attr_value(NetlistContext &netlist, const as
 }
 
 template<typename T>
-void transfer_attrs(NetlistContext &netlist, T &from, RTLIL::AttrObject *to)
+void transfer_user_attrs(NetlistContext &netlist, T &from, RTLIL::AttrObject *to)
 {
-	auto src = format_src(from);
-	if (!src.empty())
-		to->attributes[ID::src] = src;
-
 	for (auto attr : global_compilation->getAttributes(from)) {
 		if (auto value = convert_attr_value(netlist, attr)) {
 			to->attributes[id(attr->name)] = *value;
 		}
 	}
 }
+
+template<typename T>
+void transfer_attrs(NetlistContext &netlist, T &from, RTLIL::AttrObject *to)
+{
+	auto src = format_src(from);
+	if (!src.empty())
+		to->attributes[ID::src] = src;
+
+	transfer_user_attrs(netlist, from, to);
+}
 template void transfer_attrs<const ast::Symbol>(NetlistContext &netlist, const ast::Symbol &from, RTLIL::AttrObject *to);
 
 template<typename T>
@@ -310,7 +359,7 @@ static Yosys::pool<VariableBit> detect_possibly_unassigned_subset(Yosys::pool<Va
 					  "FIXME" /* log_signal(action.lvalue) */, log_signal(action.unmasked_rvalue), log_signal(action.mask));
 		}
 
-		if (action.mask.is_fully_ones())
+		if (action.unmasked())
 		for (auto bit : action.lvalue)
 			remaining.erase(bit);
 	}
@@ -365,6 +414,23 @@ static Yosys::pool<VariableBit> detect_possibly_unassigned_subset(Yosys::pool<Va
 	return remaining;
 }
 
+// For each of `signals` collect the actions assigning to it, together with the
+// corresponding mask bit, in the order in which we visit them. Two signals with
+// the same list have the same assignment enable.
+static void collect_assigning_actions(const Yosys::pool<VariableBit> &signals, Case *rule,
+		Yosys::dict<VariableBit, std::vector<std::pair<const Case::Action *, RTLIL::SigBit>>> &map)
+{
+	for (auto &action : rule->actions)
+	for (int i = 0; i < (int)action.lvalue.size(); i++) {
+		if (signals.count(action.lvalue[i]))
+			map[action.lvalue[i]].push_back({&action, action.mask_bit(i)});
+	}
+
+	for (auto switch_ : rule->switches)
+	for (auto case_ : switch_->cases)
+		collect_assigning_actions(signals, case_, map);
+}
+
 bool ProcessTiming::implicit() const
 {
 	return triggers.empty();
@@ -433,11 +499,21 @@ bool NetlistContext::is_inferred_memory(const ast::Symbol &symbol)
 	return detected_memories.count(&symbol);
 }
 
-bool NetlistContext::is_inferred_memory(const ast::Expression &expr)
+const ast::ValueSymbol *NetlistContext::memory_word_select(const ast::ElementSelectExpression &sel)
 {
+	const ast::Expression *value = &sel;
+	int depth = 0;
+	while (value->kind == ast::ExpressionKind::ElementSelect) {
+		value = &value->as<ast::ElementSelectExpression>().value();
+		depth++;
+	}
 
-	return ast::ValueExpressionBase::isKind(expr.kind) &&
-			is_inferred_memory(expr.as<ast::ValueExpressionBase>().symbol);
+	if (!ast::ValueExpressionBase::isKind(value->kind))
+		return nullptr;
+	const ast::ValueSymbol &symbol = value->as<ast::ValueExpressionBase>().symbol;
+	if (!is_inferred_memory(symbol) || memory_dimensions.at(&symbol) != depth)
+		return nullptr;
+	return &symbol;
 }
 
 std::string format_wchunk(RTLIL::SigChunk chunk)
@@ -451,6 +527,329 @@ std::string format_wchunk(RTLIL::SigChunk chunk)
 		return Yosys::stringf("%s[%d:%d]", chunk.wire->name.c_str(), chunk.offset, chunk.offset + chunk.width);
 }
 
+// Describes the structure of a module in a way which ignores source locations
+// and the exact names of private objects. Private names are numbered in order
+// of appearance: modules elaborated from identical specializations create
+// their objects in identical order.
+static std::string module_fingerprint(RTLIL::Module *mod,
+		const Yosys::dict<RTLIL::IdString, RTLIL::IdString> &cell_types)
+{
+	std::ostringstream f;
+	Yosys::dict<RTLIL::IdString, int> private_names;
+
+	auto name = [&](RTLIL::IdString id) {
+		if (id.isPublic())
+			f << id.str() << " ";
+		else
+			f << "$" << private_names.emplace(id, private_names.size()).first->second << " ";
+	};
+	auto attrs = [&](RTLIL::AttrObject *obj) {
+		for (auto &[id, value] : obj->attributes) {
+			if (id == ID::src || id == ID::hdlname)
+				continue;
+			f << "a " << id.str() << "=" << value.as_string() << " ";
+		}
+	};
+	auto sig = [&](const RTLIL::SigSpec &sig) {
+		f << "{ ";
+		for (auto &chunk : sig.chunks()) {
+			if (chunk.wire) {
+				name(chunk.wire->name);
+				f << chunk.offset << ":" << chunk.width << " ";
+			} else {
+				f << RTLIL::Const(chunk.data).as_string() << " ";
+			}
+		}
+		f << "} ";
+	};
+	auto actions = [&](const std::vector<RTLIL::SigSig> &actions) {
+		for (auto &action : actions) {
+			f << "x ";
+			sig(action.first);
+			sig(action.second);
+		}
+	};
+	std::function<void(RTLIL::CaseRule *)> case_rule = [&](RTLIL::CaseRule *rule) {
+		f << "case ";
+		attrs(rule);
+		for (auto &compare : rule->compare)
+			sig(compare);
+		actions(rule->actions);
+		for (auto sw : rule->switches) {
+			f << "switch ";
+			attrs(sw);
+			sig(sw->signal);
+			for (auto child : sw->cases)
+				case_rule(child);
+			f << "end\n";
+		}
+		f << "end\n";
+	};
+
+	attrs(mod);
+	f << "\n";
+	for (auto wire : mod->wires()) {
+		f << "w ";
+		name(wire->name);
+		f << wire->width << " " << wire->start_offset << " " << wire->upto << " "
+		  << wire->port_id << " " << wire->port_input << " " << wire->port_output << " "
+		  << wire->is_signed << " ";
+		attrs(wire);
+		f << "\n";
+	}
+	for (auto &[id, mem] : mod->memories) {
+		f << "m ";
+		name(id);
+		f << mem->width << " " << mem->start_offset << " " << mem->size << " ";
+		attrs(mem);
+		f << "\n";
+	}
+	for (auto cell : mod->cells()) {
+		f << "c ";
+		name(cell->name);
+		f << (cell_types.count(cell->type) ? cell_types.at(cell->type) : cell->type).str() << " ";
+		attrs(cell);
+		for (auto &[id, value] : cell->parameters) {
+			f << "p " << id.str() << "=";
+			if (id == ID::MEMID)
+				name(RTLIL::IdString(value.decode_string()));
+			else
+				f << value.as_string() << " ";
+		}
+		for (auto &[port, value] : cell->connections()) {
+			f << "o " << port.str() << " ";
+			sig(value);
+		}
+		f << "\n";
+	}
+	for (auto &[id, proc] : mod->processes) {
+		f << "r ";
+		name(id);
+		attrs(proc);
+		case_rule(&proc->root_case);
+		for (auto sync : proc->syncs) {
+			f << "s " << sync->type << " ";
+			sig(sync->signal);
+			actions(sync->actions);
+			for (auto &memwr : sync->mem_write_actions) {
+				f << "mw ";
+				name(memwr.memid);
+				attrs(&memwr);
+				sig(memwr.address);
+				sig(memwr.data);
+				sig(memwr.enable);
+				f << memwr.priority_mask.as_string() << " ";
+			}
+		}
+		f << "\n";
+	}
+	for (auto &conn : mod->connections()) {
+		f << "n ";
+		sig(conn.first);
+		sig(conn.second);
+		f << "\n";
+	}
+
+	return f.str();
+}
+
+// Merge modules among the given ones which are structurally identical, which
+// happens when we specialize a module for each instance path. Cells
+// instantiating the merged modules get retargeted.
+static void dedup_modules(RTLIL::Design *design, std::vector<RTLIL::IdString> &names)
+{
+	// Visit children before parents so that the fingerprints of parents
+	// can refer to the deduplicated children; we sort the modules
+	// topologically by the instantiations among them
+	Yosys::pool<RTLIL::IdString> name_set(names.begin(), names.end()), visited;
+	std::vector<RTLIL::IdString> order;
+	std::function<void(RTLIL::IdString)> visit = [&](RTLIL::IdString name) {
+		if (!name_set.count(name) || visited.count(name))
+			return;
+		visited.insert(name);
+		if (RTLIL::Module *mod = design->module(name)) {
+			for (auto cell : mod->cells())
+				visit(cell->type);
+		}
+		order.push_back(name);
+	};
+	for (auto name : names)
+		visit(name);
+
+	Yosys::dict<std::string, RTLIL::IdString> fingerprints;
+	Yosys::dict<RTLIL::IdString, RTLIL::IdString> representative;
+	for (auto name : order) {
+		RTLIL::Module *mod = design->module(name);
+		if (!mod || mod->get_bool_attribute(ID::top) || mod->get_blackbox_attribute())
+			continue;
+
+		auto [found, new_] = fingerprints.emplace(module_fingerprint(mod, representative), name);
+		if (!new_)
+			representative[name] = found->second;
+	}
+
+	if (representative.empty())
+		return;
+
+	// Name each class of identical modules after its first emitted member,
+	// the representative included, so usually nothing gets renamed
+	Yosys::pool<RTLIL::IdString> reps;
+	for (auto &[dup, rep] : representative)
+		reps.insert(rep);
+	Yosys::dict<RTLIL::IdString, RTLIL::IdString> class_name;
+	for (auto name : names) {
+		RTLIL::IdString rep = representative.count(name) ? representative.at(name) : name;
+		if (reps.count(rep))
+			class_name.emplace(rep, name);
+	}
+
+	for (auto name : names) {
+		if (representative.count(name))
+			design->remove(design->module(name));
+	}
+	for (auto [rep, name] : class_name) {
+		if (rep != name)
+			design->rename(design->module(rep), name);
+	}
+
+	auto final_name = [&](RTLIL::IdString name) {
+		if (representative.count(name))
+			name = representative.at(name);
+		return class_name.count(name) ? class_name.at(name) : name;
+	};
+
+	std::vector<RTLIL::IdString> kept;
+	for (auto name : names) {
+		if (representative.count(name) || class_name.count(name)) {
+			// only the name a class is renamed to stays
+			if (final_name(name) != name)
+				continue;
+		}
+		kept.push_back(name);
+	}
+
+	for (auto name : kept) {
+		for (auto cell : design->module(name)->cells())
+			cell->type = final_name(cell->type);
+	}
+
+	log("Merged %d structurally identical modules.\n", GetSize(representative));
+	names = kept;
+}
+
+// Counts the instances of each module definition and estimates the size of
+// one instance as the number of statements and expressions elaborated in its
+// body, including those of nested instances
+struct ReplicationEstimator : public ast::ASTVisitor<ReplicationEstimator, true, true> {
+	Yosys::dict<const ast::DefinitionSymbol *, int64_t> instances;
+	Yosys::dict<const ast::DefinitionSymbol *, int64_t> instance_size;
+	int64_t current_size = 0;
+
+	template<typename T>
+	void handle(const T &node)
+	{
+		if constexpr (std::is_base_of_v<ast::Expression, T> || std::is_base_of_v<ast::Statement, T>)
+			current_size++;
+		visitDefault(node);
+	}
+
+	void handle(const ast::GenerateBlockSymbol &sym)
+	{
+		if (sym.isUninstantiated)
+			return;
+		visitDefault(sym);
+	}
+
+	void handle(const ast::InstanceSymbol &sym)
+	{
+		int64_t outer_size = current_size;
+		current_size = 0;
+		visitDefault(sym);
+
+		auto def = &sym.getDefinition();
+		instances[def]++;
+		instance_size[def] = std::max(instance_size[def], current_size);
+		current_size += outer_size;
+	}
+};
+
+static void estimate_replication(SynthesisSettings &settings, const ast::RootSymbol &root)
+{
+	ReplicationEstimator estimator;
+	for (auto instance : root.topInstances)
+		instance->visit(estimator);
+
+	settings.replication_weight.clear();
+	for (auto [def, count] : estimator.instances) {
+		int64_t weight = count * estimator.instance_size.at(def);
+		settings.replication_weight[def] = weight;
+		log_debug("Module %s: %lld instances, weight %lld\n", std::string(def->name).c_str(),
+				  (long long) count, (long long) weight);
+	}
+}
+
+// Expands `--sweep NAME=V1,V2,...` into the `NAME=Vi` overrides of the
+// individual sweep points; without the option we have a single point with
+// no extra override
+static std::vector<std::string> parse_sweep(SynthesisSettings &settings)
+{
+	if (!settings.sweep.has_value())
+		return {""};
+
+	const std::string &arg = settings.sweep.value();
+	size_t eq = arg.find('=');
+	if (eq == std::string::npos || eq == 0 || eq + 1 == arg.size())
+		log_cmd_error("Bad argument to --sweep: expected <name>=<value>,<value>...\n");
+
+	std::vector<std::string> points;
+	std::string name = arg.substr(0, eq);
+	for (auto &value : Yosys::split_tokens(arg.substr(eq + 1), ","))
+		points.push_back(name + "=" + value);
+	if (points.empty())
+		log_cmd_error("Bad argument to --sweep: no values given\n");
+	return points;
+}
+
+// Moves the modules imported for a sweep point from the scratch design into
+// `design`, appending the point's parameter override to their names. The
+// points' top modules lose the `top` attribute so that the design doesn't
+// end up with several of them.
+static std::vector<RTLIL::IdString> move_sweep_point(RTLIL::Design &scratch, RTLIL::Design *design,
+		const std::vector<RTLIL::IdString> &names, const std::string &point)
+{
+	Yosys::dict<RTLIL::IdString, RTLIL::IdString> renames;
+	for (auto name : names)
+		renames[name] = name.str() + "$" + point;
+
+	std::vector<RTLIL::IdString> moved;
+	for (auto name : names) {
+		RTLIL::Module *mod = scratch.module(name);
+		if (design->module(renames.at(name)))
+			log_error("Module %s already exists in the design\n", log_id(renames.at(name)));
+		scratch.modules_.erase(name);
+		mod->design = nullptr;
+		mod->name = renames.at(name);
+		mod->attributes.erase(ID::top);
+		for (auto cell : mod->cells()) {
+			if (renames.count(cell->type))
+				cell->type = renames.at(cell->type);
+		}
+		design->add(mod);
+		moved.push_back(mod->name);
+	}
+
+	// blackboxes exported while importing the point
+	for (auto mod : scratch.modules().to_vector()) {
+		if (design->module(mod->name))
+			continue;
+		scratch.modules_.erase(mod->name);
+		mod->design = nullptr;
+		design->add(mod);
+	}
+
+	return moved;
+}
+
 const ast::InstanceBodySymbol &get_instance_body(SynthesisSettings &settings, const ast::InstanceSymbol &instance)
 {
 	if (!settings.disable_instance_caching && instance.getCanonicalBody())
@@ -468,6 +867,10 @@ void VariableState::set(VariableBits lhs, RTLIL::SigSpec value)
 	for (int i = 0; i < (int) lhs.size(); i++) {
 		VariableBit bit = lhs[i];
 
+		if (open_chain && visible_assignments.count(bit) &&
+				visible_assignments.at(bit).wire == open_chain)
+			open_chain = nullptr;
+
 		if (!revert.count(bit)) {
 			if (visible_assignments.count(bit))
 				revert[bit] = visible_assignments.at(bit);
@@ -486,7 +889,10 @@ RTLIL::SigSpec VariableState::evaluate(NetlistContext &netlist, VariableBits vbi
 		if (vbit.variable.kind == Variable::Dummy) {
 			ret.append(RTLIL::Sx);
 		} else if (visible_assignments.count(vbit)) {
-			ret.append(visible_assignments.at(vbit));
+			RTLIL::SigBit value = visible_assignments.at(vbit);
+			if (value.wire && value.wire == open_chain)
+				open_chain = nullptr;
+			ret.append(value);
 		} else {
 			log_assert(vbit.variable.kind == Variable::Static);
 			RTLIL::SigBit bit{netlist.wire(*vbit.variable.get_symbol()), vbit.offset};
@@ -501,7 +907,10 @@ RTLIL::SigSpec VariableState::evaluate(NetlistContext &netlist, VariableChunk vc
 	RTLIL::SigSpec ret;
 	for (int i = 0; i < vchunk.bitwidth(); i++) {
 		if (visible_assignments.count(vchunk[i])) {
-			ret.append(visible_assignments.at(vchunk[i]));
+			RTLIL::SigBit value = visible_assignments.at(vchunk[i]);
+			if (value.wire && value.wire == open_chain)
+				open_chain = nullptr;
+			ret.append(value);
 		} else {
 			log_assert(vchunk.variable.kind == Variable::Static);
 			RTLIL::SigBit bit{netlist.wire(*vchunk.variable.get_symbol()), vchunk.base + i};
@@ -513,6 +922,7 @@ RTLIL::SigSpec VariableState::evaluate(NetlistContext &netlist, VariableChunk vc
 
 void VariableState::save(Map &save)
 {
+	open_chain = nullptr;
 	revert.swap(save);
 }
 
@@ -521,6 +931,8 @@ std::pair<VariableBits, RTLIL::SigSpec> VariableState::restore(Map &save)
 	VariableBits lreverted;
 	RTLIL::SigSpec rreverted;
 
+	open_chain = nullptr;
+
 	for (auto pair : revert)
 		lreverted.push_back(pair.first);
 	std::sort(lreverted.begin(), lreverted.end());
@@ -553,11 +965,14 @@ int EvalContext::find_nest_level(const ast::Scope *scope)
 
 Variable EvalContext::variable(const ast::ValueSymbol &symbol)
 {
+	auto it = netlist.variable_ranks.find(&symbol);
+	int rank = (it != netlist.variable_ranks.end()) ? it->second : -1;
+
 	if (ast::VariableSymbol::isKind(symbol.kind) &&
 			symbol.as<ast::VariableSymbol>().lifetime == ast::VariableLifetime::Automatic) {
-		return Variable::from_symbol(&symbol, find_nest_level(symbol.getParentScope()));
+		return Variable::from_symbol(&symbol, find_nest_level(symbol.getParentScope()), rank);
 	} else {
-		return Variable::from_symbol(&symbol);
+		return Variable::from_symbol(&symbol, -1, rank);
 	}
 }
 
@@ -721,7 +1136,7 @@ RTLIL::SigSpec EvalContext::operator()(ast::Symbol const &symbol)
 			require(valsym, valsym.getInitializer());
 			auto exprconst = valsym.getInitializer()->eval(this->const_);
 			require(valsym, exprconst.isInteger());
-			return convert_svint(exprconst.integer());
+			return convert_svint(exprconst.integer(), &netlist.emitted_z);
 		}
 		break;
 	default:
@@ -732,29 +1147,38 @@ RTLIL::SigSpec EvalContext::operator()(ast::Symbol const &symbol)
 VariableBits EvalContext::streaming_lhs(ast::StreamingConcatenationExpression const &expr)
 {
 	require(expr, expr.isFixedSize());
-	VariableBits cat;
+	std::vector<VariableBits> items;
+	size_t total = 0;
 
 	for (auto stream : expr.streams()) {
 		require(*stream.operand, !stream.withExpr);
 		auto& op = *stream.operand;
-		VariableBits item;
 
 		if (op.kind == ast::ExpressionKind::Streaming)
-			item = streaming_lhs(op.as<ast::StreamingConcatenationExpression>());
+			items.push_back(streaming_lhs(op.as<ast::StreamingConcatenationExpression>()));
 		else
-			item = lhs(*stream.operand);
-
-		cat = {cat, item};
+			items.push_back(lhs(*stream.operand));
+		total += items.back().size();
 	}
 
+	// the first stream ends up in the most significant position
+	VariableBits cat;
+	cat.reserve(total);
+	for (auto it = items.rbegin(); it != items.rend(); it++)
+		cat.append(*it);
+
 	require(expr, expr.getSliceSize() <= std::numeric_limits<int>::max());
 	int slice = expr.getSliceSize();
 	if (slice == 0) {
 		return cat;
 	} else {
+		// reverse the order of slices, the last slice can be partial
 		VariableBits reorder;
-		for (int i = 0; i < cat.size(); i += slice)
-			reorder = {reorder, cat.extract(i, std::min(slice, cat.bitwidth() - i))};
+		reorder.reserve(total);
+		int last = (cat.bitwidth() - 1) / slice * slice;
+		for (int i = last; i >= 0; i -= slice)
+			reorder.insert(reorder.end(), cat.begin() + i,
+						   cat.begin() + std::min(i + slice, cat.bitwidth()));
 		return reorder;
 	}
 }
@@ -762,29 +1186,38 @@ VariableBits EvalContext::streaming_lhs(ast::StreamingConcatenationExpression co
 RTLIL::SigSpec EvalContext::streaming(ast::StreamingConcatenationExpression const &expr)
 {
 	require(expr, expr.isFixedSize());
-	RTLIL::SigSpec cat;
+	std::vector<RTLIL::SigSpec> items;
 
 	for (auto stream : expr.streams()) {
 		require(*stream.operand, !stream.withExpr);
 		auto& op = *stream.operand;
-		RTLIL::SigSpec item;
 
 		if (op.kind == ast::ExpressionKind::Streaming)
-			item = streaming(op.as<ast::StreamingConcatenationExpression>());
+			items.push_back(streaming(op.as<ast::StreamingConcatenationExpression>()));
 		else
-			item = (*this)(*stream.operand);
-
-		cat = {cat, item};
+			items.push_back((*this)(*stream.operand));
 	}
 
+	// the first stream ends up in the most significant position
+	RTLIL::SigSpec cat;
+	for (auto it = items.rbegin(); it != items.rend(); it++)
+		cat.append(*it);
+
 	require(expr, expr.getSliceSize() <= std::numeric_limits<int>::max());
 	int slice = expr.getSliceSize();
-	if (slice == 0) {
+	if (slice == 0 || cat.size() == 0) {
 		return cat;
 	} else {
-		RTLIL::SigSpec reorder;
-		for (int i = 0; i < cat.size(); i += slice)
-			reorder = {reorder, cat.extract(i, std::min(slice, cat.size() - i))};
+		// reverse the order of slices, the last slice can be partial; we go
+		// through a bit vector as extracting from a SigSpec with many chunks
+		// is linear in the number of chunks
+		std::vector<RTLIL::SigBit> bits = cat.to_sigbit_vector();
+		std::vector<RTLIL::SigBit> reorder;
+		reorder.reserve(bits.size());
+		int last = (cat.size() - 1) / slice * slice;
+		for (int i = last; i >= 0; i -= slice)
+			reorder.insert(reorder.end(), bits.begin() + i,
+						   bits.begin() + std::min(i + slice, cat.size()));
 		return reorder;
 	}
 }
@@ -855,21 +1288,25 @@ RTLIL::SigSpec handle_past(EvalContext &eval, const ast::CallExpression &call)
 	// Use the first trigger (clock) from the procedural timing
 	auto &trigger = procedural->timing.triggers[0];
 
-	// Create a chain of DFFs for num_cycles delay
-	RTLIL::SigSpec prev_val = current_val;
-	RTLIL::Wire *past_wire = nullptr;
+	if (num_cycles < 1)
+		return current_val;
 
-	for (int i = 0; i < num_cycles; i++) {
-		past_wire = netlist.canvas->addWire(netlist.new_id("$past"), width);
+	// Extend the chain of DFFs we have for this signal and clock, if any,
+	// to num_cycles delay
+	auto &chain = netlist.past_chains[{trigger.signal, trigger.edge_polarity, current_val}];
+
+	while ((int)chain.size() < num_cycles) {
+		RTLIL::SigSpec prev_val = chain.empty() ? current_val : chain.back();
+		RTLIL::Wire *past_wire = netlist.canvas->addWire(netlist.new_id("$past"), width);
 		netlist.canvas->addDff(netlist.new_id("$past"),
 			trigger.signal,
 			prev_val,
 			past_wire,
 			trigger.edge_polarity);
-		prev_val = past_wire;
+		chain.push_back(past_wire);
 	}
 
-	return past_wire;
+	return chain[num_cycles - 1];
 }
 
 void handle_display(ProceduralContext &context, const ast::CallExpression &call)
@@ -919,6 +1356,80 @@ void handle_display(ProceduralContext &context, const ast::CallExpression &call)
 	fmt.emit_rtlil(cell);
 }
 
+bool EvalContext::may_fold(ast::Expression const &expr)
+{
+	auto it = may_fold_cache.find(&expr);
+	if (it != may_fold_cache.end())
+		return it->second;
+
+	bool ret = true;
+	switch (expr.kind) {
+	case ast::ExpressionKind::NamedValue:
+	case ast::ExpressionKind::HierarchicalValue: {
+		const ast::Symbol &symbol = expr.as<ast::ValueExpressionBase>().symbol;
+		if (symbol.kind == ast::SymbolKind::Net)
+			ret = false;
+		else if (ast::VariableSymbol::isKind(symbol.kind))
+			ret = symbol.as<ast::VariableSymbol>().flags.has(ast::VariableFlags::Const);
+		break;
+	}
+	case ast::ExpressionKind::UnaryOp:
+		ret = may_fold(expr.as<ast::UnaryExpression>().operand());
+		break;
+	case ast::ExpressionKind::BinaryOp: {
+		const auto &biop = expr.as<ast::BinaryExpression>();
+		switch (biop.op) {
+		// short-circuiting operators may fold with a non-constant operand
+		case ast::BinaryOperator::LogicalAnd:
+		case ast::BinaryOperator::LogicalOr:
+		case ast::BinaryOperator::LogicalImplication:
+			break;
+		default:
+			// evaluate both sides to fill in the cache
+			ret = may_fold(biop.left());
+			ret = may_fold(biop.right()) && ret;
+			break;
+		}
+		break;
+	}
+	case ast::ExpressionKind::ElementSelect: {
+		const auto &sel = expr.as<ast::ElementSelectExpression>();
+		ret = may_fold(sel.value());
+		ret = may_fold(sel.selector()) && ret;
+		break;
+	}
+	case ast::ExpressionKind::RangeSelect: {
+		const auto &sel = expr.as<ast::RangeSelectExpression>();
+		ret = may_fold(sel.value());
+		ret = may_fold(sel.left()) && ret;
+		ret = may_fold(sel.right()) && ret;
+		break;
+	}
+	case ast::ExpressionKind::MemberAccess:
+		ret = may_fold(expr.as<ast::MemberAccessExpression>().value());
+		break;
+	case ast::ExpressionKind::Conversion:
+		ret = may_fold(expr.as<ast::ConversionExpression>().operand());
+		break;
+	case ast::ExpressionKind::Concatenation:
+		for (auto op : expr.as<ast::ConcatenationExpression>().operands())
+			ret = may_fold(*op) && ret;
+		break;
+	case ast::ExpressionKind::Replication: {
+		const auto &repl = expr.as<ast::ReplicationExpression>();
+		ret = may_fold(repl.count());
+		ret = may_fold(repl.concat()) && ret;
+		break;
+	}
+	default:
+		// no insight, leave it up to slang
+		break;
+	}
+
+	may_fold_cache[&expr] = ret;
+	return ret;
+}
+
 RTLIL::SigSpec EvalContext::operator()(ast::Expression const &expr)
 {
 	RTLIL::Module *mod = netlist.canvas;
@@ -939,7 +1450,7 @@ RTLIL::SigSpec EvalContext::operator()(ast::Expression const &expr)
 		goto error;
 	}
 
-	if (/* flag for testing */ !ignore_ast_constants ||
+	if ((/* flag for testing */ !ignore_ast_constants && may_fold(expr)) ||
 			expr.kind == ast::ExpressionKind::IntegerLiteral ||
 			expr.kind == ast::ExpressionKind::RealLiteral ||
 			expr.kind == ast::ExpressionKind::UnbasedUnsizedIntegerLiteral ||
@@ -1170,7 +1681,7 @@ RTLIL::SigSpec EvalContext::operator()(ast::Expression const &expr)
 	case ast::ExpressionKind::IntegerLiteral:
 		{
 			const ast::IntegerLiteral &lit = expr.as<ast::IntegerLiteral>();
-			ret = convert_svint(lit.getValue());
+			ret = convert_svint(lit.getValue(), &netlist.emitted_z);
 		}
 		break;
 	case ast::ExpressionKind::RangeSelect:
@@ -1184,35 +1695,20 @@ RTLIL::SigSpec EvalContext::operator()(ast::Expression const &expr)
 		{
 			const ast::ElementSelectExpression &elemsel = expr.as<ast::ElementSelectExpression>();
 
-			if (netlist.is_inferred_memory(elemsel.value())) {
-				int width = elemsel.type->getBitstreamWidth();
-				RTLIL::IdString id = netlist.id(elemsel.value()
-										.as<ast::ValueExpressionBase>().symbol);
-				RTLIL::Cell *memrd = netlist.canvas->addCell(netlist.new_id(), ID($memrd_v2));
-				memrd->setParam(ID::MEMID, id.str());
-				memrd->setParam(ID::CLK_ENABLE, false);
-				memrd->setParam(ID::CLK_POLARITY, false);
-				memrd->setParam(ID::TRANSPARENCY_MASK, RTLIL::Const(0, 0));
-				memrd->setParam(ID::COLLISION_X_MASK, RTLIL::Const(0, 0));
-				memrd->setParam(ID::CE_OVER_SRST, false);
-				memrd->setParam(ID::ARST_VALUE, RTLIL::Const(RTLIL::Sx, width));
-				memrd->setParam(ID::SRST_VALUE, RTLIL::Const(RTLIL::Sx, width));
-				memrd->setParam(ID::INIT_VALUE, RTLIL::Const(RTLIL::Sx, width));
-				memrd->setPort(ID::CLK, RTLIL::Sx);
-				memrd->setPort(ID::EN, RTLIL::S1);
-				memrd->setPort(ID::ARST, RTLIL::S0);
-				memrd->setPort(ID::SRST, RTLIL::S0);
-				// TODO: signedness
-				RTLIL::SigSpec addr = (*this)(elemsel.selector());
-				memrd->setPort(ID::ADDR, addr);
-				memrd->setParam(ID::ABITS, addr.size());
-				ret = netlist.canvas->addWire(netlist.new_id(), width);
-				memrd->setPort(ID::DATA, ret);
-				memrd->setParam(ID::WIDTH, width);
+			if (auto memory = netlist.memory_word_select(elemsel)) {
+				// out-of-range reads are undefined, no need for a validity check
+				RTLIL::Cell *memrd = add_async_memrd(netlist, netlist.id(*memory),
+						memory_address(elemsel), elemsel.type->getBitstreamWidth());
+				ret = memrd->getPort(ID::DATA);
 				transfer_attrs(netlist, expr, memrd);
 				break;
 			}
 
+			if (auto rom = rom_read(elemsel)) {
+				ret = *rom;
+				break;
+			}
+
 			Addressing<RTLIL::SigSpec> addr(*this, elemsel);
 			ret = addr.mux((*this)(elemsel.value()), elemsel.type->getBitstreamWidth());
 		}
@@ -1288,6 +1784,34 @@ RTLIL::SigSpec EvalContext::operator()(ast::Expression const &expr)
 					auto arg = call.arguments()[0];
 					auto sig = (*this)(*arg);
 					ret = netlist.CountOnes(sig, (int)call.type->getBitstreamWidth());
+				} else if (name == "$onehot" || name == "$onehot0") {
+					require(expr, call.arguments().size() == 1);
+					auto sig = (*this)(*call.arguments()[0]);
+					ret = netlist.OneHot(sig, name == "$onehot0");
+				} else if (name == "$countbits") {
+					require(expr, call.arguments().size() >= 1);
+					auto sig = (*this)(*call.arguments()[0]);
+					bool count_zeroes = false, count_ones = false;
+					for (auto control : call.arguments().subspan(1)) {
+						auto cv = control->eval(const_);
+						ast_invariant(*control, cv.isInteger());
+						slang::logic_t bit = cv.integer()[0];
+						if (bit.isUnknown()) {
+							// Bits of a synthesized signal are never x or z
+							netlist.add_diag(diag::LangFeatureUnsupported, control->sourceRange);
+							goto error;
+						}
+						(bit.value ? count_ones : count_zeroes) = true;
+					}
+					int width = (int)call.type->getBitstreamWidth();
+					if (count_ones && count_zeroes)
+						ret = RTLIL::Const(sig.size(), width);
+					else if (count_ones)
+						ret = netlist.CountOnes(sig, width);
+					else if (count_zeroes)
+						ret = netlist.CountOnes(netlist.Not(sig), width);
+					else
+						ret = RTLIL::Const(0, width);
 				} else if (name == "$past") {
 					ret = handle_past(*this, call);
 				} else {
@@ -1343,6 +1867,167 @@ RTLIL::SigSpec EvalContext::eval_signed(ast::Expression const &expr)
 		return (*this)(expr);
 }
 
+// Adds an asynchronous read port on the given memory
+static RTLIL::Cell *add_async_memrd(NetlistContext &netlist, RTLIL::IdString memid,
+									RTLIL::SigSpec addr, int width)
+{
+	RTLIL::Cell *memrd = netlist.canvas->addCell(netlist.new_id(), ID($memrd_v2));
+	memrd->setParam(ID::MEMID, memid.str());
+	memrd->setParam(ID::CLK_ENABLE, false);
+	memrd->setParam(ID::CLK_POLARITY, false);
+	memrd->setParam(ID::TRANSPARENCY_MASK, RTLIL::Const(0, 0));
+	memrd->setParam(ID::COLLISION_X_MASK, RTLIL::Const(0, 0));
+	memrd->setParam(ID::CE_OVER_SRST, false);
+	memrd->setParam(ID::ARST_VALUE, RTLIL::Const(RTLIL::Sx, width));
+	memrd->setParam(ID::SRST_VALUE, RTLIL::Const(RTLIL::Sx, width));
+	memrd->setParam(ID::INIT_VALUE, RTLIL::Const(RTLIL::Sx, width));
+	memrd->setPort(ID::CLK, RTLIL::Sx);
+	memrd->setPort(ID::EN, RTLIL::S1);
+	memrd->setPort(ID::ARST, RTLIL::S0);
+	memrd->setPort(ID::SRST, RTLIL::S0);
+	memrd->setPort(ID::ADDR, addr);
+	memrd->setParam(ID::ABITS, addr.size());
+	memrd->setPort(ID::DATA, netlist.canvas->addWire(netlist.new_id(), width));
+	memrd->setParam(ID::WIDTH, width);
+	return memrd;
+}
+
+std::optional<RTLIL::SigSpec> EvalContext::rom_read(ast::ElementSelectExpression const &sel)
+{
+	const ast::Expression &value = sel.value();
+	if (ignore_ast_constants || !value.type->isArray() || !value.type->hasFixedRange()
+			|| !may_fold(value))
+		return {};
+
+	// single-bit selects are left to the bitwise shifters
+	int width = sel.type->getBitstreamWidth();
+	auto range = value.type->getFixedRange();
+	if (width < 2 || (int64_t) range.width() * width < netlist.settings.rom_threshold())
+		return {};
+
+	// Tables held in parameters are shared by all reads from the module
+	const ast::Symbol *symbol = nullptr;
+	if (value.kind == ast::ExpressionKind::NamedValue &&
+			value.as<ast::NamedValueExpression>().symbol.kind == ast::SymbolKind::Parameter)
+		symbol = &value.as<ast::NamedValueExpression>().symbol;
+
+	RTLIL::IdString memid;
+	if (symbol && netlist.emitted_roms.count(symbol)) {
+		memid = netlist.emitted_roms.at(symbol);
+	} else {
+		auto data = value.eval(const_);
+		if (!data)
+			return {};
+		auto converted = netlist.convert_const(data, value.sourceRange.start());
+		if (!converted)
+			return {};
+		ast_invariant(sel, converted->size() == (int) range.width() * width);
+
+		RTLIL::Memory *m = new RTLIL::Memory;
+		m->name = symbol ? netlist.id(*symbol) : netlist.new_id();
+		transfer_attrs(netlist, value, m);
+		m->width = width;
+		// with a negative lower bound the address gets rebased to zero, see below
+		m->start_offset = std::max(range.lower(), 0);
+		m->size = range.width();
+		netlist.canvas->memories[m->name] = m;
+		memid = m->name;
+
+		// The data is laid out like the initializer of an inferred memory,
+		// see `PopulateNetlist::transfer_var_init`
+		RTLIL::Cell *meminit = netlist.canvas->addCell(netlist.new_id(), ID($meminit_v2));
+		meminit->setParam(ID::MEMID, memid.str());
+		meminit->setParam(ID::PRIORITY, 0);
+		meminit->setParam(ID::ABITS, 32);
+		meminit->setParam(ID::WORDS, m->size);
+		meminit->setParam(ID::WIDTH, m->width);
+		meminit->setPort(ID::ADDR, m->start_offset);
+		meminit->setPort(ID::DATA, range.isLittleEndian() ? *converted : reverse_data(*converted, m->width));
+		meminit->setPort(ID::EN, RTLIL::Const(RTLIL::S1, m->width));
+
+		if (symbol)
+			netlist.emitted_roms[symbol] = memid;
+		log_debug("ROM emitted for lookup into %s (size: %d, width: %d)\n",
+				  log_id(memid), m->size, m->width);
+	}
+
+	// Out-of-range reads are undefined, no need for a validity check, and
+	// the address may wrap around for them. Where the range reaches into
+	// negative indices, subtract the lower bound (respecting the signedness
+	// of the selector) so that the ROM is addressed from zero.
+	RTLIL::SigSpec addr = (*this)(sel.selector());
+	if (range.lower() < 0) {
+		bool is_signed = sel.selector().type->isSigned();
+		addr = netlist.Biop(ID($add), addr, RTLIL::Const(-range.lower(), 32),
+							is_signed, is_signed, std::max(ceil_log2(range.width()), 1));
+	}
+	RTLIL::Cell *memrd = add_async_memrd(netlist, memid, addr, width);
+	transfer_attrs(netlist, sel, memrd);
+	return memrd->getPort(ID::DATA);
+}
+
+RTLIL::SigSpec EvalContext::memory_address(ast::ElementSelectExpression const &sel, RTLIL::SigSpec *valid)
+{
+	// Collect the selects starting from the innermost dimension
+	std::vector<const ast::ElementSelectExpression *> chain;
+	for (const ast::Expression *expr = &sel; expr->kind == ast::ExpressionKind::ElementSelect;
+			expr = &expr->as<ast::ElementSelectExpression>().value())
+		chain.push_back(&expr->as<ast::ElementSelectExpression>());
+
+	if (chain.size() == 1) {
+		// one-dimensional memories are addressed by the index itself,
+		// the memory's `start_offset` accounts for the range
+		if (valid)
+			*valid = {RTLIL::S1};
+		return (*this)(sel.selector());
+	}
+
+	int64_t words = 1;
+	for (auto level : chain)
+		words *= level->value().type->getFixedRange().width();
+	int abits = std::max(ceil_log2(words), 1);
+
+	// Words are numbered in the order they appear in the bitstream of the
+	// full variable; where all the inner dimensions are powers of two the
+	// address is a plain concatenation of the per-dimension positions
+	RTLIL::SigSpec addr;
+	int64_t stride = 1;
+	if (valid)
+		*valid = {RTLIL::S1};
+	for (auto level : chain) {
+		Addressing<RTLIL::SigSpec> addressing(*this, *level);
+		int width = addressing.range.width();
+		int base = addressing.base_offset;
+
+		if (valid)
+			*valid = netlist.LogicAnd(*valid, netlist.LogicAnd(
+					addressing.raw_ge(-base, RTLIL::Const(-base, 32)),
+					addressing.raw_lt(width - base, RTLIL::Const(width - base, 32))));
+
+		int bits = ceil_log2(width);
+		RTLIL::SigSpec pos;
+		if (base) {
+			pos = netlist.Biop(ID($add), addressing.raw_signal, RTLIL::Const(base, 32),
+							   true, true, bits);
+		} else {
+			pos = addressing.raw_signal;
+			pos.extend_u0(bits, true);
+		}
+
+		if (stride == (int64_t(1) << addr.size())) {
+			addr = {pos, addr};
+		} else {
+			addr.extend_u0(abits);
+			addr = netlist.Biop(ID($add), addr,
+					netlist.Biop(ID($mul), pos, RTLIL::Const(stride, abits), false, false, abits),
+					false, false, abits);
+		}
+		stride *= width;
+	}
+	addr.extend_u0(abits);
+	return addr;
+}
+
 EvalContext::EvalContext(NetlistContext &netlist)
 	: netlist(netlist), procedural(nullptr),
 	  const_(ast::ASTContext(netlist.compilation.getRoot(), ast::LookupLocation::max))
@@ -1379,6 +2064,51 @@ struct HierarchyQueue {
 	std::vector<NetlistContext *> queue;
 };
 
+// How a built-in gate or switch primitive maps onto internal cells
+struct PrimitiveOp {
+	enum {
+		Gate,		// and, or, xor, ...: word-level cell for two inputs, reduction otherwise
+		Buffer,		// buf, not: fan-out to all but the last port
+		Pull,		// pullup, pulldown
+		Tristate,	// bufif0, notif1, nmos, ...
+		Cmos,		// cmos, rcmos
+	} kind;
+	RTLIL::IdString type, reduce_type;
+	bool inv_y = false, inv_a = false, inv_en = false;
+	RTLIL::State pull = RTLIL::Sx;
+};
+
+static const PrimitiveOp *lookup_primitive(const ast::PrimitiveSymbol &prim)
+{
+	static const std::map<std::string_view, PrimitiveOp> table = {
+		{"and",		{PrimitiveOp::Gate, ID($and), ID($reduce_and)}},
+		{"or",		{PrimitiveOp::Gate, ID($or), ID($reduce_or)}},
+		{"nand",	{PrimitiveOp::Gate, ID($and), ID($reduce_and), true}},
+		{"nor",		{PrimitiveOp::Gate, ID($or), ID($reduce_or), true}},
+		{"xor",		{PrimitiveOp::Gate, ID($xor), ID($reduce_xor)}},
+		{"xnor",	{PrimitiveOp::Gate, ID($xnor), ID($reduce_xnor)}},
+		{"buf",		{PrimitiveOp::Buffer, ID($buf)}},
+		{"not",		{PrimitiveOp::Buffer, ID($not)}},
+		{"pullup",	{PrimitiveOp::Pull, {}, {}, false, false, false, RTLIL::S1}},
+		{"pulldown",{PrimitiveOp::Pull, {}, {}, false, false, false, RTLIL::S0}},
+		{"bufif0",	{PrimitiveOp::Tristate, {}, {}, false, false, true}},
+		{"bufif1",	{PrimitiveOp::Tristate}},
+		{"notif0",	{PrimitiveOp::Tristate, {}, {}, false, true, true}},
+		{"notif1",	{PrimitiveOp::Tristate, {}, {}, false, true, false}},
+		{"pmos",	{PrimitiveOp::Tristate, {}, {}, false, false, true}},
+		{"rpmos",	{PrimitiveOp::Tristate, {}, {}, false, false, true}},
+		{"nmos",	{PrimitiveOp::Tristate}},
+		{"rnmos",	{PrimitiveOp::Tristate}},
+		{"cmos",	{PrimitiveOp::Cmos}},
+		{"rcmos",	{PrimitiveOp::Cmos}},
+	};
+
+	if (prim.primitiveKind == ast::PrimitiveSymbol::PrimitiveKind::UserDefined)
+		return nullptr;
+	auto it = table.find(prim.name);
+	return it != table.end() ? &it->second : nullptr;
+}
+
 struct PopulateNetlist : public TimingPatternInterpretor, public ast::ASTVisitor<PopulateNetlist, true, false> {
 public:
 	HierarchyQueue &queue;
@@ -1387,6 +2117,92 @@ public:
 	InferredMemoryDetector mem_detect;
 	std::vector<NetlistContext> deferred_modules;
 
+	// Modports reached through an interface connection, flattened across
+	// interface arrays, together with the signals in this module which
+	// back their ports
+	struct ModportConnection {
+		std::vector<std::pair<const ast::Scope *, std::string>> modports;
+		std::vector<std::pair<const ast::ModportPortSymbol *, RTLIL::Wire *>> ports;
+	};
+
+	// Keyed by the connected interface instance, the modport name and the
+	// array ranges declared on the interface port
+	using ModportConnectionKey = std::tuple<const ast::Symbol *, std::string_view,
+											std::vector<std::pair<int32_t, int32_t>>>;
+	std::map<ModportConnectionKey, ModportConnection> modport_connections;
+
+	const ModportConnection &modport_connection(const ast::InterfacePortSymbol &port_symbol,
+			const ast::Symbol &iface_instance, const ast::ModportSymbol &ref_modport)
+	{
+		std::span<const slang::ConstantRange> array_range;
+		switch (iface_instance.kind) {
+		case ast::SymbolKind::InstanceArray: {
+			auto range1 = port_symbol.getDeclaredRange();
+			ast_invariant(port_symbol, range1.has_value());
+			array_range = range1.value();
+			break;
+		}
+		case ast::SymbolKind::Instance:
+			break;
+		default:
+			log_abort();
+			break;
+		}
+
+		ModportConnectionKey key{&iface_instance, ref_modport.name, {}};
+		for (auto &dim : array_range)
+			std::get<2>(key).emplace_back(dim.left, dim.right);
+
+		auto [it, inserted] = modport_connections.try_emplace(std::move(key));
+		ModportConnection &wiring = it->second;
+		if (!inserted)
+			return wiring;
+
+		std::string hierpath_suffix = "";
+		int array_level = 0;
+
+		iface_instance.visit(ast::makeVisitor(
+			[&](auto &visitor, const ast::InstanceArraySymbol &symbol) {
+				// Mock instance array symbols made up by slang don't contain
+				// the instances as members, but they do contain them as elements
+				std::string save = hierpath_suffix;
+				int i = 0;
+				for (auto &elem : symbol.elements) {
+					auto dim = array_range[array_level];
+					int hdl_index = dim.lower() + i;
+					i++;
+					hierpath_suffix += "[" + std::to_string(hdl_index) + "]";
+					array_level++;
+					elem->visit(visitor);
+					array_level--;
+					hierpath_suffix = save;
+				}
+			},
+			[&](auto &visitor, const ast::ModportSymbol &modport) {
+				// To support interface arrays, we need to match all modports
+				// with the same name as ref_modport
+				if (!modport.name.compare(ref_modport.name)) {
+					wiring.modports.emplace_back(&static_cast<const ast::Scope&>(modport),
+												 hierpath_suffix);
+					visitor.visitDefault(modport);
+				}
+			},
+			[&](auto&, const ast::ModportPortSymbol &port) {
+				ast_invariant(port, port.internalSymbol);
+				const ast::Scope *parent = port.getParentScope();
+				ast_invariant(port, parent->asSymbol().kind == ast::SymbolKind::Modport);
+				const ast::ModportSymbol &modport = parent->asSymbol().as<ast::ModportSymbol>();
+
+				if (netlist.scopes_remap.count(&modport))
+					wiring.ports.emplace_back(&port, netlist.wire(port));
+				else
+					wiring.ports.emplace_back(&port, netlist.wire(*port.internalSymbol));
+			}
+		));
+
+		return wiring;
+	}
+
 	struct InitialEvalVisitor : SlangInitial::EvalVisitor {
 		NetlistContext &netlist;
 		RTLIL::Module *mod;
@@ -1519,6 +2335,52 @@ public:
 		netlist.GroupConnect(cl, cr);
 	}
 
+	// Split a chunk driven from a clocked process into the chunks for which we
+	// emit separate flops, paired with the name suffixes to use for those. When
+	// we don't split by fields, `fields` receives them for `annotate_flop_fields`,
+	// ordered by their offset into the variable.
+	std::vector<NamedChunk> flop_chunks(VariableChunk chunk, const ast::Type *type,
+										std::vector<NamedChunk> &fields)
+	{
+		fields = generate_subfield_names(chunk, type);
+		if (!settings.no_split_flops.value_or(false) || fields.size() <= 1) {
+			std::vector<NamedChunk> ret;
+			ret.swap(fields);
+			return ret;
+		}
+
+		std::sort(fields.begin(), fields.end(), [](const NamedChunk &a, const NamedChunk &b) {
+			return a.first.base < b.first.base;
+		});
+		return {{chunk, chunk.slice_text()}};
+	}
+
+	// List the fields overlapping the `width` bits from `base` which `cell`
+	// drives, with offsets relative to the cell
+	void annotate_flop_fields(RTLIL::Cell *cell, const std::vector<NamedChunk> &fields,
+							  int base, int width)
+	{
+		if (fields.empty())
+			return;
+
+		// the fields partition the variable chunk, so a binary search finds
+		// the first one to overlap and the rest follow in order
+		auto it = std::partition_point(fields.begin(), fields.end(), [&](const NamedChunk &field) {
+			return field.first.base + field.first.bitwidth() <= base;
+		});
+
+		std::string text;
+		for (; it != fields.end() && it->first.base < base + width; it++) {
+			auto &[field_chunk, name] = *it;
+			int lo = std::max(field_chunk.base, base);
+			int hi = std::min(field_chunk.base + field_chunk.bitwidth(), base + width);
+			if (!text.empty())
+				text += " ";
+			text += Yosys::stringf("%s:%d:%d", name.c_str(), lo - base, hi - lo);
+		}
+		cell->attributes[ID(slang_fields)] = RTLIL::Const(text);
+	}
+
 	void handle_ff_process(const ast::ProceduralBlockSymbol &symbol,
 						   const ast::SignalEventControl &clock,
 						   const ast::StatementBlockSymbol *prologue_block,
@@ -1594,10 +2456,60 @@ public:
 			EnterAutomaticScopeGuard guard(sync_procedure.eval, prologue_block);
 			sync_procedure.inherit_state(prologue);
 			sync_body.visit(StatementExecutor(sync_procedure));
-			sync_procedure.copy_case_tree_into(proc->root_case);
 
 			// FIXME: ignores variables not driven from the sync procedure
 			VariableBits driven = sync_procedure.all_driven();
+
+			// Bits which are left unassigned on some path through the sync body get
+			// a $dffe with the enable derived from the case tree, same as we derive
+			// latch enables, rather than a $dff with a hold path for opt_dff to
+			// rediscover. Map from those bits to the enable and data signal.
+			Yosys::dict<VariableBit, RTLIL::SigSig> signaling;
+			if (aloads.empty() && clock.edge != ast::EdgeKind::BothEdges) {
+				Yosys::pool<VariableBit> candidates;
+				for (auto bit : driven)
+					if (!prologue.vstate.visible_assignments.count(bit))
+						candidates.insert(bit);
+
+				Yosys::pool<VariableBit> dangling =
+					detect_possibly_unassigned_subset(candidates, sync_procedure.root_case.get());
+
+				VariableBits enable_driven;
+				for (auto bit : driven)
+					if (dangling.count(bit))
+						enable_driven.append(bit);
+
+				if (!enable_driven.empty()) {
+					// Bits assigned by the same actions under the same mask bits
+					// share an enable
+					Yosys::dict<VariableBit, std::vector<std::pair<const Case::Action *, RTLIL::SigBit>>> assigning_actions;
+					collect_assigning_actions(dangling, sync_procedure.root_case.get(), assigning_actions);
+					std::map<std::vector<std::pair<const Case::Action *, RTLIL::SigBit>>, int> enable_groups;
+					for (auto bit : enable_driven)
+						enable_groups.insert({assigning_actions.at(bit), (int)enable_groups.size()});
+
+					RTLIL::SigSpec enables = netlist.canvas->addWire(netlist.new_id(), enable_groups.size());
+					RTLIL::SigSpec all_staging;
+					for (auto chunk : enable_driven.chunks()) {
+						RTLIL::SigSpec staging = netlist.canvas->addWire(netlist.new_id(), chunk.bitwidth());
+						for (int i = 0; i < chunk.bitwidth(); i++)
+							signaling[chunk[i]] = {enables[enable_groups.at(assigning_actions.at(chunk[i]))], staging[i]};
+						all_staging.append(staging);
+					}
+
+					// The $dffe cells take the data from the staging signals, so
+					// we don't need the values merged with the hold path
+					sync_procedure.drop_merge_path(dangling);
+
+					sync_procedure.root_case->aux_actions.push_back(
+								{enables, RTLIL::SigSpec(RTLIL::S0, enables.size())});
+					sync_procedure.root_case->aux_actions.push_back(
+								{all_staging, RTLIL::SigSpec(RTLIL::Sx, all_staging.size())});
+					sync_procedure.root_case->insert_latch_signaling(netlist, signaling);
+				}
+			}
+
+			sync_procedure.copy_case_tree_into(proc->root_case);
 			for (VariableChunk driven_chunk : driven.chunks()) {
 				const ast::Type *type = &driven_chunk.variable.get_symbol()->getType();
 				RTLIL::SigSpec assigned = sync_procedure.vstate.evaluate(netlist, driven_chunk);
@@ -1607,25 +2519,51 @@ public:
 
 				if (aloads.empty()) {
 
-					for (auto [named_chunk, name] : generate_subfield_names(driven_chunk, type)) {
+					std::vector<NamedChunk> fields;
+					for (auto [named_chunk, name] : flop_chunks(driven_chunk, type, fields)) {
 						log_assert(named_chunk.variable.get_symbol() != nullptr);
 						std::string base_name = Yosys::stringf("$driver$%s%s",
 							RTLIL::unescape_id(netlist.id(*named_chunk.variable.get_symbol())).c_str(), name.c_str());
 
 						if (clock.edge == ast::EdgeKind::BothEdges) {
-							netlist.add_dual_edge_aldff(base_name,
+							auto [pos_ff, neg_ff] = netlist.add_dual_edge_aldff(base_name,
 														timing.triggers[0].signal,
 														RTLIL::S0,
 														assigned.extract(named_chunk.base - driven_chunk.base, named_chunk.bitwidth()),
 														netlist.convert_static(named_chunk),
 														RTLIL::SigSpec(RTLIL::Sx, named_chunk.bitwidth()),
 														true);
+							annotate_flop_fields(pos_ff, fields, named_chunk.base, named_chunk.bitwidth());
+							annotate_flop_fields(neg_ff, fields, named_chunk.base, named_chunk.bitwidth());
 						} else {
-							netlist.add_dff(netlist.canvas->uniquify(base_name),
-											timing.triggers[0].signal,
-											assigned.extract(named_chunk.base - driven_chunk.base, named_chunk.bitwidth()),
-											netlist.convert_static(named_chunk),
-											timing.triggers[0].edge_polarity);
+							RTLIL::SigSpec d = assigned.extract(named_chunk.base - driven_chunk.base, named_chunk.bitwidth());
+							RTLIL::SigSpec q = netlist.convert_static(named_chunk);
+
+							// Split into runs of bits with a common enable, or no enable
+							for (int i = 0, j; i < named_chunk.bitwidth(); i = j) {
+								VariableBit bit = named_chunk[i];
+								if (!signaling.count(bit)) {
+									for (j = i + 1; j < named_chunk.bitwidth() && !signaling.count(named_chunk[j]); j++);
+									RTLIL::Cell *cell = netlist.add_dff(netlist.canvas->uniquify(base_name),
+													timing.triggers[0].signal,
+													d.extract(i, j - i),
+													q.extract(i, j - i),
+													timing.triggers[0].edge_polarity);
+									annotate_flop_fields(cell, fields, named_chunk.base + i, j - i);
+								} else {
+									RTLIL::SigSpec staging = signaling.at(bit).second;
+									for (j = i + 1; j < named_chunk.bitwidth() && signaling.count(named_chunk[j]) &&
+											signaling.at(named_chunk[j]).first == signaling.at(bit).first; j++)
+										staging.append(signaling.at(named_chunk[j]).second);
+									RTLIL::Cell *cell = netlist.add_dffe(netlist.canvas->uniquify(base_name),
+													 timing.triggers[0].signal,
+													 signaling.at(bit).first,
+													 staging,
+													 q.extract(i, j - i),
+													 timing.triggers[0].edge_polarity);
+									annotate_flop_fields(cell, fields, named_chunk.base + i, j - i);
+								}
+							}
 						}
 					}
 				} else if (aloads.size() == 1) {
@@ -1641,23 +2579,26 @@ public:
 							dffe_q.append(driven_chunk[i]);
 					}
 
+					std::vector<NamedChunk> fields;
 					if (!aldff_q.empty()) {
 						for (auto driven_chunk2 : aldff_q.chunks())
-						for (auto [named_chunk, name] : generate_subfield_names(driven_chunk2, type)) {
+						for (auto [named_chunk, name] : flop_chunks(driven_chunk2, type, fields)) {
 							log_assert(named_chunk.variable.get_symbol() != nullptr);
 							std::string base_name = Yosys::stringf("$driver$%s%s",
 								RTLIL::unescape_id(netlist.id(*named_chunk.variable.get_symbol())).c_str(), name.c_str());
 
 							if (clock.edge == ast::EdgeKind::BothEdges) {
-								netlist.add_dual_edge_aldff(base_name,
+								auto [pos_ff, neg_ff] = netlist.add_dual_edge_aldff(base_name,
 															timing.triggers[0].signal,
 															aloads[0].trigger,
 															assigned.extract(named_chunk.base - driven_chunk.base, named_chunk.bitwidth()),
 															netlist.convert_static(named_chunk),
 															aloads[0].values.evaluate(netlist, named_chunk),
 															aloads[0].trigger_polarity);
+								annotate_flop_fields(pos_ff, fields, named_chunk.base, named_chunk.bitwidth());
+								annotate_flop_fields(neg_ff, fields, named_chunk.base, named_chunk.bitwidth());
 							} else {
-								netlist.add_aldff(netlist.canvas->uniquify(base_name),
+								RTLIL::Cell *cell = netlist.add_aldff(netlist.canvas->uniquify(base_name),
 												  timing.triggers[0].signal,
 												  aloads[0].trigger,
 												  assigned.extract(named_chunk.base - driven_chunk.base, named_chunk.bitwidth()),
@@ -1665,6 +2606,7 @@ public:
 												  aloads[0].values.evaluate(netlist, named_chunk),
 												  timing.triggers[0].edge_polarity,
 												  aloads[0].trigger_polarity);
+								annotate_flop_fields(cell, fields, named_chunk.base, named_chunk.bitwidth());
 							}
 						}
 					}
@@ -1677,17 +2619,18 @@ public:
 						}
 
 						for (auto driven_chunk2 : dffe_q.chunks())
-						for (auto [named_chunk, name] : generate_subfield_names(driven_chunk2, type)) {
+						for (auto [named_chunk, name] : flop_chunks(driven_chunk2, type, fields)) {
 							std::string base_name = Yosys::stringf("$driver$%s%s",
 								RTLIL::unescape_id(netlist.id(*named_chunk.variable.get_symbol())).c_str(), name.c_str());
 
-							netlist.add_dffe(netlist.canvas->uniquify(base_name),
+							RTLIL::Cell *cell = netlist.add_dffe(netlist.canvas->uniquify(base_name),
 											 timing.triggers[0].signal,
 											 aloads[0].trigger,
 											 assigned.extract(named_chunk.base - driven_chunk.base, named_chunk.bitwidth()),
 											 netlist.convert_static(named_chunk),
 											 timing.triggers[0].edge_polarity,
 											 !aloads[0].trigger_polarity);
+							annotate_flop_fields(cell, fields, named_chunk.base, named_chunk.bitwidth());
 						}
 					}
 				} else {
@@ -1766,7 +2709,7 @@ public:
 			internal_signal = netlist.eval.lhs(*expr);
 		} else {
 			ast_invariant(port, ast::ValueSymbol::isKind(port.internalSymbol->kind));
-			internal_signal = Variable::from_symbol(&port.internalSymbol->as<ast::ValueSymbol>());
+			internal_signal = netlist.eval.variable(port.internalSymbol->as<ast::ValueSymbol>());
 		}
 
 		log_assert(internal_signal.bitwidth() == signal.size());
@@ -1932,95 +2875,42 @@ public:
 
 					const ast::Symbol &iface_instance = *conn->getIfaceConn().first;
 					const ast::ModportSymbol &ref_modport = *conn->getIfaceConn().second;
-					std::span<const slang::ConstantRange> array_range;
-
-					const ast::Scope *iface_scope;
-					switch (iface_instance.kind) {
-					case ast::SymbolKind::InstanceArray: {
-						iface_scope = static_cast<const ast::Scope *>(
-										&iface_instance.as<ast::InstanceArraySymbol>());
-						auto range1 = conn->port.as<ast::InterfacePortSymbol>().getDeclaredRange();
-						ast_invariant(conn->port, range1.has_value());
-						array_range = range1.value();
-						break;
-					}
-					case ast::SymbolKind::Instance:
-						iface_scope = static_cast<const ast::Scope *>(
-										&iface_instance.as<ast::InstanceSymbol>().body);
-						break;
-					default:
-						log_abort();
-						break;
+					const ModportConnection &wiring = modport_connection(
+							conn->port.as<ast::InterfacePortSymbol>(), iface_instance, ref_modport);
+
+					if (inserted) {
+						std::string port_name = submodule.id(conn->port).str();
+						for (auto &[modport, hierpath_suffix] : wiring.modports)
+							submodule.scopes_remap[modport] = port_name + hierpath_suffix;
 					}
 
-					std::string hierpath_suffix = "";
-					int array_level = 0;
-
-					iface_instance.visit(ast::makeVisitor(
-						[&](auto &visitor, const ast::InstanceArraySymbol &symbol) {
-							// Mock instance array symbols made up by slang don't contain
-							// the instances as members, but they do contain them as elements
-							std::string save = hierpath_suffix;
-							int i = 0;
-							for (auto &elem : symbol.elements) {
-								auto dim = array_range[array_level];
-								int hdl_index = dim.lower() + i;
-								i++;
-								hierpath_suffix += "[" + std::to_string(hdl_index) + "]";
-								array_level++;
-								elem->visit(visitor);
-								array_level--;
-								hierpath_suffix = save;
-							}
-						},
-						[&](auto &visitor, const ast::ModportSymbol &modport) {
-							// To support interface arrays, we need to match all modports
-							// with the same name as ref_modport
-							if (!modport.name.compare(ref_modport.name)) {
-								if (inserted) {
-									submodule.scopes_remap[&static_cast<const ast::Scope&>(modport)] =
-															submodule.id(conn->port).str() + hierpath_suffix;
-								}
-								visitor.visitDefault(modport);
+					for (auto [port, signal] : wiring.ports) {
+						RTLIL::Wire *wire;
+						if (inserted) {
+							wire = submodule.add_wire(*port);
+							log_assert(wire);
+							switch (port->direction) {
+							case ast::ArgumentDirection::In:
+								wire->port_input = true;
+								break;
+							case ast::ArgumentDirection::Out:
+								wire->port_output = true;
+								break;
+							case ast::ArgumentDirection::InOut:
+								wire->port_input = true;
+								wire->port_output = true;
+								break;
+							default: {
+								auto &diag = netlist.add_diag(diag::UnsupportedPortDirection, port->location);
+								diag << ast::toString(port->direction);
+								break;
 							}
-						},
-						[&](auto&, const ast::ModportPortSymbol &port) {
-							RTLIL::Wire *wire;
-							if (inserted) {
-								wire = submodule.add_wire(port);
-								log_assert(wire);
-								switch (port.direction) {
-								case ast::ArgumentDirection::In:
-									wire->port_input = true;
-									break;
-								case ast::ArgumentDirection::Out:
-									wire->port_output = true;
-									break;
-								case ast::ArgumentDirection::InOut:
-									wire->port_input = true;
-									wire->port_output = true;
-									break;
-								default: {
-									auto &diag = netlist.add_diag(diag::UnsupportedPortDirection, port.location);
-									diag << ast::toString(port.direction);
-									break;
-								}
-								}
-							} else {
-								wire = submodule.wire(port);
 							}
-
-							ast_invariant(port, port.internalSymbol);
-							const ast::Scope *parent = port.getParentScope();
-							ast_invariant(port, parent->asSymbol().kind == ast::SymbolKind::Modport);
-							const ast::ModportSymbol &modport = parent->asSymbol().as<ast::ModportSymbol>();
-
-							if (netlist.scopes_remap.count(&modport))
-								cell->setPort(wire->name, netlist.wire(port));
-							else
-								cell->setPort(wire->name, netlist.wire(*port.internalSymbol));
+						} else {
+							wire = submodule.wire(*port);
 						}
-					));
+						cell->setPort(wire->name, signal);
+					}
 					break;
 				}
 				case ast::SymbolKind::MultiPort: {
@@ -2073,11 +2963,14 @@ public:
 	{
 		mem_detect.process(body);
 		netlist.detected_memories = mem_detect.memory_candidates;
+		for (auto symbol : netlist.detected_memories)
+			netlist.memory_dimensions[symbol] = mem_detect.memory_dimensions(*symbol);
 	}
 
 	void add_internal_wires(const ast::InstanceBodySymbol &body)
 	{
 		std::unordered_set<const slang::ast::SubroutineSymbol *> visited_subroutines;
+		std::vector<const ast::ValueSymbol *> ranked;
 		body.visit(ast::makeVisitor([&](auto&, const ast::ValueSymbol &sym) {
 			if (!sym.getType().isFixedSize())
 				return;
@@ -2087,6 +2980,9 @@ public:
 					&& sym.kind != ast::SymbolKind::FormalArgument)
 				return;
 
+			// automatic variables get no wire but we rank them all the same
+			ranked.push_back(&sym);
+
 			if (sym.kind == ast::SymbolKind::Variable
 					&& sym.as<ast::VariableSymbol>().lifetime == ast::VariableLifetime::Automatic)
 				return;
@@ -2121,10 +3017,24 @@ public:
 				m->set_string_attribute(ID::hdlname, netlist.hdlname(sym));
 				transfer_attrs(netlist, sym, m);
 				m->name = netlist.id(sym);
-				m->width = sym.getType().getArrayElementType()->getBitstreamWidth();
-				auto range = sym.getType().getFixedRange();
-				m->start_offset = range.lower();
-				m->size = range.width();
+				int dims = netlist.memory_dimensions.at(&sym);
+				if (dims == 1) {
+					auto range = sym.getType().getFixedRange();
+					m->width = sym.getType().getArrayElementType()->getBitstreamWidth();
+					m->start_offset = range.lower();
+					m->size = range.width();
+				} else {
+					// Words are numbered in the order they appear in the bitstream
+					// of the full variable, see `EvalContext::memory_address`
+					const ast::Type *type = &sym.getType();
+					m->size = 1;
+					for (int i = 0; i < dims; i++) {
+						m->size *= type->getFixedRange().width();
+						type = type->getArrayElementType();
+					}
+					m->width = type->getBitstreamWidth();
+					m->start_offset = 0;
+				}
 				netlist.canvas->memories[m->name] = m;
 				netlist.emitted_mems[m->name] = {};
 
@@ -2153,6 +3063,8 @@ public:
 				return;
 			visitor.visitDefault(sym);
 		}));
+
+		netlist.variable_ranks = rank_symbols(std::move(ranked));
 	}
 
 	void initialize_var_init(const ast::InstanceBodySymbol &body)
@@ -2204,12 +3116,15 @@ public:
 						meminit->setParam(ID::WIDTH, m->width);
 						meminit->setPort(ID::ADDR, m->start_offset);
 						bool little_endian = sym.getType().getFixedRange().isLittleEndian();
+						if (netlist.memory_dimensions.at(&sym) > 1)
+							little_endian = true; // addressed in bitstream order
 						meminit->setPort(ID::DATA, little_endian ? *converted : reverse_data(*converted, m->width));
 						meminit->setPort(ID::EN, RTLIL::Const(RTLIL::S1, m->width));
 					} else {
 						auto wire = netlist.wire(sym);
 						log_assert(wire);
 						wire->attributes[ID::init] = *converted;
+						netlist.settings.module_features[netlist.canvas->name].init_wires.push_back(wire->name);
 					}
 				}
 			}
@@ -2261,8 +3176,12 @@ public:
 
 		RTLIL::Cell *cell = netlist.canvas->addCell(netlist.id(sym),
 													id(sym.definitionName));
-		cell->set_string_attribute(ID::hdlname, netlist.hdlname(sym));
-		transfer_attrs(netlist, sym, cell);
+		if (!netlist.settings.gate_netlist.value_or(false)) {
+			cell->set_string_attribute(ID::hdlname, netlist.hdlname(sym));
+			transfer_attrs(netlist, sym, cell);
+		} else {
+			transfer_user_attrs(netlist, sym, cell);
+		}
 
 		auto port_names = sym.getPortNames();
 		auto port_conns = sym.getPortConnections();
@@ -2313,154 +3232,149 @@ public:
 		visitDefault(sym);
 	}
 
+	Yosys::dict<const ast::PrimitiveSymbol *, const PrimitiveOp *> primitive_ops;
+
 	void handle(const ast::PrimitiveInstanceSymbol &sym)
 	{
 		auto ports = sym.getPortConnections();
-		auto type = sym.primitiveType.name;
+		const PrimitiveOp *prim;
+		if (auto it = primitive_ops.find(&sym.primitiveType); it != primitive_ops.end()) {
+			prim = it->second;
+		} else {
+			prim = primitive_ops[&sym.primitiveType] = lookup_primitive(sym.primitiveType);
+		}
+
+		if (!prim) {
+			if (sym.primitiveType.primitiveKind == ast::PrimitiveSymbol::PrimitiveKind::UserDefined) {
+				// User-defined primitives (UDPs) are unsupported
+				netlist.add_diag(diag::UdpUnsupported, sym.location);
+			} else {
+				// bidir (tran/rtran/tranif0/rtranif0/tranif1/rtranif1) are unsupported
+				netlist.add_diag(diag::PrimTypeUnsupported, sym.location);
+			}
+			return;
+		}
+
+		// Under --gate-netlist we skip formatting the source locations but keep
+		// the attributes given in the source
+		bool gate_netlist = netlist.settings.gate_netlist.value_or(false);
+		auto annotate = [&](RTLIL::Cell *cell) {
+			if (gate_netlist)
+				transfer_user_attrs(netlist, sym, cell);
+			else
+				transfer_attrs(netlist, sym, cell);
+		};
 		auto id = (!sym.name.compare("")) ? netlist.new_id() : netlist.id(sym);
-		RTLIL::IdString op;
-		bool inv_y = false;
-		RTLIL::Cell *cell;
 		ast_invariant(sym, ports.front()->kind == ast::ExpressionKind::Assignment);
 		auto &assign = ports.front()->as<ast::AssignmentExpression>();
 		auto y = netlist.eval.connection_lhs(assign);
-		switch (sym.primitiveType.primitiveKind) {
-		case ast::PrimitiveSymbol::PrimitiveKind::NInput:
-			{
-				// and, or, xor, xnor, nand, nor
-				if (!type.compare("and")) {
-					op = (ports.size() == 3) ? ID($and) : ID($reduce_and);
-				} else if (!type.compare("or")) {
-					op = (ports.size() == 3) ? ID($or) : ID($reduce_or);
-				} else if (!type.compare("nand")) {
-					op = (ports.size() == 3) ? ID($and) : ID($reduce_and);
-					inv_y = 1;
-				} else if (!type.compare("nor")) {
-					op = (ports.size() == 3) ? ID($or) : ID($reduce_or);
-					inv_y = 1;
-				} else if (!type.compare("xor")) {
-					op = (ports.size() == 3) ? ID($xor) : ID($reduce_xor);
-				} else if (!type.compare("xnor")) {
-					op = (ports.size() == 3) ? ID($xnor) : ID($reduce_xnor);
-				} else {
-					ast_unreachable(sym);
-				}
-				cell = netlist.canvas->addCell(id, op);
-				if (ports.size() == 3) {
-					// word-level primitive cell for 2 input ports
-					cell->setPort(ID::A, netlist.eval(*ports[1]));
-					cell->setPort(ID::B, netlist.eval(*ports[2]));
-				} else {
-					// reduce_* cell for 3 or more input ports
-					RTLIL::SigSpec a;
-					for (auto port : ports)
-						if (port != ports.front())
-							a.append(netlist.eval(*port));
-					cell->setPort(ID::A, a);
-				}
-				cell->setPort(ID::Y, y);
-				break;
+		RTLIL::Cell *cell;
+
+		switch (prim->kind) {
+		case PrimitiveOp::Gate:
+			if (ports.size() == 3) {
+				// word-level primitive cell for 2 input ports
+				auto a = netlist.eval(*ports[1]);
+				auto b = netlist.eval(*ports[2]);
+				cell = netlist.canvas->addCell(id, prim->type);
+				cell->setParam(ID::A_SIGNED, 0);
+				cell->setParam(ID::B_SIGNED, 0);
+				cell->setParam(ID::A_WIDTH, a.size());
+				cell->setParam(ID::B_WIDTH, b.size());
+				cell->setParam(ID::Y_WIDTH, y.size());
+				cell->setPort(ID::A, a);
+				cell->setPort(ID::B, b);
+			} else {
+				// reduce_* cell for 3 or more input ports
+				RTLIL::SigSpec a;
+				for (auto port : ports.subspan(1))
+					a.append(netlist.eval(*port));
+				cell = netlist.canvas->addCell(id, prim->reduce_type);
+				cell->setParam(ID::A_SIGNED, 0);
+				cell->setParam(ID::A_WIDTH, a.size());
+				cell->setParam(ID::Y_WIDTH, y.size());
+				cell->setPort(ID::A, a);
 			}
-		case ast::PrimitiveSymbol::PrimitiveKind::NOutput:
-			{
-				// buf, not
-				// Last port is input, all others are outputs
-				if (!type.compare("buf")) {
-					op = ID($buf);
-				} else if (!type.compare("not")) {
-					op = ID($not);
-				} else {
-					ast_unreachable(sym);
-				}
-				cell = netlist.canvas->addCell(id, op);
-				cell->setPort(ID::A, netlist.eval(*(ports.back())));
-				cell->setPort(ID::Y, y);
-				for (auto port : ports) {
-					if (port != ports.front() && port != ports.back()) {
-						auto &assign = port->as<ast::AssignmentExpression>();
-						netlist.canvas->connect(cell->getPort(ID::Y), netlist.eval.connection_lhs(assign));
-					}
-				}
-				break;
+			cell->setPort(ID::Y, y);
+			break;
+		case PrimitiveOp::Buffer:
+			// buf, not
+			// Last port is input, all others are outputs
+			cell = add_buffer(id, prim->type, netlist.eval(*ports.back()), y);
+			for (auto port : ports.subspan(1, ports.size() - 2)) {
+				auto &assign = port->as<ast::AssignmentExpression>();
+				netlist.canvas->connect(y, netlist.eval.connection_lhs(assign));
 			}
-		case ast::PrimitiveSymbol::PrimitiveKind::UserDefined:
-			{
-				// User-defined primitives (UDPs) are unsupported
-				netlist.add_diag(diag::UdpUnsupported, sym.location);
-				break;
+			break;
+		case PrimitiveOp::Pull:
+			// pullup/pulldown are equivalent to: buffer with constant input
+			cell = add_buffer(id, ID($buf), RTLIL::Const(prim->pull, y.size()), y);
+			break;
+		case PrimitiveOp::Tristate: {
+			// These are all tri-state buffers, some having inverted enable/output
+			// Use $mux instead of $tribuf to avoid Yosys issues...
+			auto in = netlist.eval(*ports[1]);
+			if (prim->inv_a) {
+				auto mid_wire = netlist.canvas->addWire(id.str() + "_mid", in.size());
+				auto inv_cell = netlist.canvas->addNot(id.str() + "_ainv", in, mid_wire);
+				in = mid_wire;
+				annotate(inv_cell);
 			}
+			netlist.emitted_z = true;
+			auto a = prim->inv_en ? in : RTLIL::Sz;
+			auto b = prim->inv_en ? RTLIL::Sz : in;
+			auto en = netlist.eval(*ports[2]);
+			cell = netlist.canvas->addMux(id, a, b, en, y);
+			break;
+		}
+		case PrimitiveOp::Cmos: {
+			// cmos (w, datain, ncontrol, pcontrol);
+			// is equivalent to:
+			// nmos (w, datain, ncontrol); pmos (w, datain, pcontrol);
+			// Use $mux instead of $tribuf to avoid Yosys issues...
+			auto a = netlist.eval(*ports[1]);
+			auto n_en = netlist.eval(*ports[2]);
+			auto p_en = netlist.eval(*ports[3]);
+			netlist.emitted_z = true;
+			auto nmos = netlist.canvas->addMux(id.str() + "_n", RTLIL::Sz, a, n_en, y);
+			auto pmos = netlist.canvas->addMux(id.str() + "_p", a, RTLIL::Sz, p_en, y);
+			annotate(nmos);
+			cell = pmos; // transfer_attrs to pmos below
+			break;
+		}
 		default:
-			{
-				if (!type.compare("pulldown")) {
-					// pulldown is equivalent to: buffer with constant 0 input
-					cell = netlist.canvas->addCell(id, ID($buf));
-					cell->setPort(ID::A, RTLIL::S0);
-					cell->setPort(ID::Y, y);
-				} else if (!type.compare("pullup")) {
-					// pullup is equivalent to: buffer with constant 1 input
-					cell = netlist.canvas->addCell(id, ID($buf));
-					cell->setPort(ID::A, RTLIL::S1);
-					cell->setPort(ID::Y, y);
-				} else if (!type.compare("bufif0") || !type.compare("bufif1") ||
-				           !type.compare("notif0") || !type.compare("notif1") ||
-					         !type.compare("pmos")   || !type.compare("rpmos")  ||
-					         !type.compare("nmos")   || !type.compare("rnmos")) {
-					// These are all tri-state buffers, some having inverted enable/output
-					// Use $mux instead of $tribuf to avoid Yosys issues...
-					bool inv_a = false;
-					bool inv_en = false;
-					if (!type.compare("notif0")) {
-						inv_a = inv_en = true;
-					} else if (!type.compare("notif1")) {
-						inv_a = true;
-					} else if (!type.compare("bufif0")) {
-						inv_en = true;
-					} else if (!type.compare("pmos")) {
-						inv_en = true;
-					} else if (!type.compare("rpmos")) {
-						inv_en = true;
-					}
-					auto in = netlist.eval(*ports[1]);
-					if (inv_a) {
-						auto mid_wire = netlist.canvas->addWire(id.str() + "_mid", in.size());
-						auto inv_cell = netlist.canvas->addNot(id.str() + "_ainv", in, mid_wire);
-						in = mid_wire;
-						transfer_attrs(netlist, sym, inv_cell);
-					}
-					auto a = inv_en ? in : RTLIL::Sz;
-					auto b = inv_en ? RTLIL::Sz : in;
-					auto en = netlist.eval(*ports[2]);
-					cell = netlist.canvas->addMux(id, a, b, en, y);
-				} else if (!type.compare("cmos") || !type.compare("rcmos")) {
-					// cmos (w, datain, ncontrol, pcontrol);
-					// is equivalent to:
-					// nmos (w, datain, ncontrol); pmos (w, datain, pcontrol);
-					// Use $mux instead of $tribuf to avoid Yosys issues...
-					auto a = netlist.eval(*ports[1]);
-					auto n_en = netlist.eval(*ports[2]);
-					auto p_en = netlist.eval(*ports[3]);
-					auto nmos = netlist.canvas->addMux(id.str() + "_n", RTLIL::Sz, a, n_en, y);
-					auto pmos = netlist.canvas->addMux(id.str() + "_p", a, RTLIL::Sz, p_en, y);
-					transfer_attrs(netlist, sym, nmos);
-					cell = pmos; // transfer_attrs to pmos after switch block
-				} else {
-					// bidir (tran/rtran/tranif0/rtranif0/tranif1/rtranif1) are unsupported
-					netlist.add_diag(diag::PrimTypeUnsupported, sym.location);
-				}
-			}
+			ast_unreachable(sym);
 		}
-		if (cell->type == ID($buf) && !Yosys::yosys_celltypes.cell_known(cell->type))
-			cell->type = ID($pos); // backwards compatibility for yosys < 0.46 (no $buf cells)
-		cell->fixup_parameters();
-		transfer_attrs(netlist, sym, cell);
-		if (inv_y) {
+
+		annotate(cell);
+		if (prim->inv_y) {
 			// Invert output signal where needed
 			netlist.canvas->rename(cell->name, id.str() + "_yinv");
 			auto mid_wire = netlist.canvas->addWire(id.str() + "_mid", y.size());
 			auto inv_cell = netlist.canvas->addNot(id, mid_wire, y);
 			cell->setPort(ID::Y, mid_wire);
-			transfer_attrs(netlist, sym, inv_cell);
+			annotate(inv_cell);
+		}
+	}
+
+	RTLIL::Cell *add_buffer(RTLIL::IdString id, RTLIL::IdString type, RTLIL::SigSpec a, RTLIL::SigSpec y)
+	{
+		// backwards compatibility for yosys < 0.46 (no $buf cells)
+		static const bool have_buf = Yosys::yosys_celltypes.cell_known(ID($buf));
+		if (type == ID($buf) && !have_buf)
+			type = ID($pos);
+
+		RTLIL::Cell *cell = netlist.canvas->addCell(id, type);
+		if (type == ID($buf)) {
+			cell->setParam(ID::WIDTH, y.size());
+		} else {
+			cell->setParam(ID::A_SIGNED, 0);
+			cell->setParam(ID::A_WIDTH, a.size());
+			cell->setParam(ID::Y_WIDTH, y.size());
 		}
+		cell->setPort(ID::A, a);
+		cell->setPort(ID::Y, y);
+		return cell;
 	}
 
 	void handle(const ast::PropertySymbol &sym) {
@@ -2714,11 +3628,8 @@ bool NetlistContext::should_dissolve(const ast::InstanceSymbol &sym, slang::Diag
 	if (sym.isInterface())
 		return true;
 
-	// the rest depends on the hierarchy mode
-	switch (settings.hierarchy_mode()) {
-	case SynthesisSettings::NONE:
-		return true;
-	case SynthesisSettings::BEST_EFFORT: {
+	// whether the instance can be kept under best-effort rules
+	auto keepable = [&]() {
 		for (auto *conn : sym.getPortConnections()) {
 			switch (conn->port.kind) {
 			case ast::SymbolKind::Port:
@@ -2726,17 +3637,35 @@ bool NetlistContext::should_dissolve(const ast::InstanceSymbol &sym, slang::Diag
 				break;
 			case ast::SymbolKind::InterfacePort:
 				if (!conn->getIfaceConn().second)
-					return true;
+					return false;
 				break;
 			default:
-				return true;
+				return false;
 				break;
 			}
 		}
 
-		if (!sym.isModule())
+		return sym.isModule();
+	};
+
+	// the rest depends on the hierarchy mode
+	switch (settings.hierarchy_mode()) {
+	case SynthesisSettings::NONE:
+		return true;
+	case SynthesisSettings::BEST_EFFORT:
+		return !keepable();
+	case SynthesisSettings::AUTO: {
+		if (!keepable())
 			return true;
 
+		auto it = settings.replication_weight.find(&sym.getDefinition());
+		if (it == settings.replication_weight.end() || it->second < settings.auto_hierarchy.value())
+			return true;
+
+		if (why_not_dissolved) {
+			auto &note = why_not_dissolved->addNote(diag::NoteModuleNotDissolvedBecauseReplicated, sym.location);
+			note << sym.body.name;
+		}
 		return false;
 		}
 	case SynthesisSettings::ALL:
@@ -2866,12 +3795,42 @@ NetlistContext::NetlistContext(
 {
 }
 
+void NetlistContext::finalize()
+{
+	log_assert(!finalized);
+	finalized = true;
+
+	canvas->fixup_ports();
+	if (!settings.no_netlist_check.value_or(false))
+		canvas->check();
+
+	if (settings.blame)
+		settings.blame->account(canvas, realm.getDefinition().name);
+	settings.module_features[canvas->name].has_z |= emitted_z;
+
+	Yosys::dict<const ast::Symbol*, RTLIL::Wire *> port_wires;
+	for (auto [symbol, wire] : wire_cache) {
+		if (wire->port_id)
+			port_wires[symbol] = wire;
+	}
+	wire_cache.swap(port_wires);
+
+	decltype(detected_memories)().swap(detected_memories);
+	decltype(memory_dimensions)().swap(memory_dimensions);
+	decltype(emitted_mems)().swap(emitted_mems);
+	decltype(emitted_roms)().swap(emitted_roms);
+	decltype(variable_ranks)().swap(variable_ranks);
+	decltype(past_chains)().swap(past_chains);
+	decltype(issued_diagnostics)().swap(issued_diagnostics);
+}
+
 NetlistContext::~NetlistContext()
 {
 	// move constructor could have cleared our canvas pointer
-	if (canvas) {
+	if (canvas && !finalized) {
 		canvas->fixup_ports();
-		canvas->check();
+		if (!settings.no_netlist_check.value_or(false))
+			canvas->check();
 	}
 }
 
@@ -2905,6 +3864,11 @@ static std::vector<std::vector<std::string>> defaults_stack;
 
 void fixup_options(SynthesisSettings &settings, slang::driver::Driver &driver)
 {
+	if (settings.lint_only.value_or(false)) {
+		// the netlist gets discarded, no point in checking it
+		settings.no_netlist_check = true;
+	}
+
 	if (!settings.no_synthesis_define.value_or(false)) {
 		driver.options.defines.push_back("SYNTHESIS=1");
 	}
@@ -2967,6 +3931,73 @@ void catch_forbidden_options(slang::driver::Driver &driver) {
 	}
 }
 
+static std::vector<RTLIL::Wire *> collect_init_wires(RTLIL::Module *module)
+{
+	std::vector<RTLIL::Wire *> ret;
+	for (auto wire : module->wires()) {
+		if (wire->attributes.count(ID::init))
+			ret.push_back(wire);
+	}
+	return ret;
+}
+
+// Connects the undriven bits among the given wires to their initializers.
+// Drivers are only tracked for bits of those wires.
+static void resolve_undriven(RTLIL::Module *module, const std::vector<RTLIL::Wire *> &wires)
+{
+	for (auto proc : module->processes) {
+		if (!proc.second->syncs.empty())
+			log_error("Process %s in module %s contains sync rules, that's unsupported by the 'undriven' command.\n",
+					  log_id(proc.second), log_id(module));
+	}
+
+	Yosys::pool<RTLIL::Wire *> candidates;
+	for (auto wire : wires) {
+		if (wire->attributes.count(ID::init) && !wire->port_input)
+			candidates.insert(wire);
+	}
+	if (candidates.empty())
+		return;
+
+	Yosys::pool<RTLIL::SigBit> driven;
+	auto add_driven = [&](const RTLIL::SigSpec &sig) {
+		for (auto &chunk : sig.chunks()) {
+			if (!chunk.wire || !candidates.count(chunk.wire))
+				continue;
+			for (int i = 0; i < chunk.width; i++)
+				driven.insert(RTLIL::SigBit(chunk.wire, chunk.offset + i));
+		}
+	};
+
+	std::function<void(RTLIL::CaseRule *rule)> visit_case = [&](RTLIL::CaseRule *rule) {
+		for (auto &action : rule->actions)
+			add_driven(action.first);
+
+		for (auto switch_ : rule->switches) {
+			for (auto case_ : switch_->cases)
+				visit_case(case_);
+		}
+	};
+
+	for (auto proc : module->processes)
+		visit_case(&proc.second->root_case);
+
+	for (auto conn : module->connections())
+		add_driven(conn.first);
+
+	for (auto cell : module->cells())
+	for (auto &conn : cell->connections())
+	if (cell->output(conn.first))
+		add_driven(conn.second);
+
+	for (auto wire : candidates) {
+		const Const &init = wire->attributes.at(ID::init);
+		for (int i = 0; i < wire->width; i++)
+		if (!driven.count(SigBit(wire, i)) && i < init.size() && (init[i] == RTLIL::S1 || init[i] == RTLIL::S0))
+			module->connect(SigBit(wire, i), init[i]);
+	}
+}
+
 struct SlangFrontend : Frontend {
 	SlangFrontend() : Frontend("slang", "read SystemVerilog (slang)") {}
 
@@ -3083,126 +4114,302 @@ struct SlangFrontend : Frontend {
 		if (!driver.processOptions())
 			log_cmd_error("Bad command\n");
 		catch_forbidden_options(driver);
+		std::vector<std::string> sweep_points = parse_sweep(settings);
+		if (settings.max_netlist_errors.has_value() && settings.max_netlist_errors.value() < 1)
+			log_cmd_error("Argument to --max-netlist-errors must be a positive number\n");
+		if (settings.rom_threshold_.has_value() && settings.rom_threshold_.value() < 1)
+			log_cmd_error("Argument to --rom-threshold must be a positive number\n");
+
+		std::ofstream emit_file;
+		if (settings.emit.has_value()) {
+			if (settings.sweep.has_value())
+				log_cmd_error("Options --emit and --sweep can't be combined\n");
+			if (!settings.lint_only.value_or(false)) {
+				emit_file.open(settings.emit.value());
+				if (emit_file.fail())
+					log_cmd_error("Can't open file `%s' for writing\n", settings.emit.value().c_str());
+				emit_file << "# Generated by read_slang --emit\n";
+			}
+		}
 
 		try {
 			if (!driver.parseAllSources())
 				log_error("Parsing failed\n");
 
-			auto compilation = driver.createCompilation();
-
-			if (settings.extern_modules.value_or(true))
-				import_blackboxes_from_rtlil(driver.sourceManager, *compilation, design);
+			bool in_succesful_failtest = false;
 
-			if (settings.dump_ast.value_or(false)) {
-				slang::JsonWriter writer;
-				writer.setPrettyPrint(true);
-				ast::ASTSerializer serializer(*compilation, writer);
-				serializer.serialize(compilation->getRoot());
-				std::cout << writer.view() << std::endl;
-			}
+			BlameReport blame;
+			if (settings.blame_report.has_value())
+				settings.blame = &blame;
+
+			// Each sweep point is elaborated from the same syntax trees with
+			// a different parameter override on the top
+			auto base_overrides = driver.options.paramOverrides;
+			for (auto &point : sweep_points) {
+				if (!point.empty()) {
+					log("Elaborating sweep point %s.\n", point.c_str());
+					driver.options.paramOverrides = base_overrides;
+					driver.options.paramOverrides.push_back(point);
+				}
 
-			bool in_succesful_failtest = false;
+				auto compilation = driver.createCompilation();
 
-			driver.reportCompilation(*compilation,/* quiet */ false);
-			if (check_diagnostics(driver.diagEngine, compilation->getAllDiagnostics(), /*last=*/false))
-				in_succesful_failtest = true;
+				if (settings.extern_modules.value_or(true))
+					import_blackboxes_from_rtlil(driver.sourceManager, *compilation, design);
 
-			if (driver.diagEngine.getNumErrors()) {
-				// Stop here should there have been any errors from AST compilation,
-				// PopulateNetlist requires a well-formed AST without error nodes
-				(void) driver.reportDiagnostics(/* quiet */ false);
-				if (!in_succesful_failtest)
-					log_error("Compilation failed\n");
-				return;
-			}
+				if (settings.dump_ast.value_or(false)) {
+					slang::JsonWriter writer;
+					writer.setPrettyPrint(true);
+					ast::ASTSerializer serializer(*compilation, writer);
+					serializer.serialize(compilation->getRoot());
+					std::cout << writer.view() << std::endl;
+				}
 
-			if (settings.ast_compilation_only.value_or(false)) {
-				(void) driver.reportDiagnostics(/* quiet */ false);
-				return;
-			}
+				driver.reportCompilation(*compilation,/* quiet */ false);
+				if (check_diagnostics(driver.diagEngine, compilation->getAllDiagnostics(), /*last=*/false))
+					in_succesful_failtest = true;
 
-			global_compilation = &(*compilation);
-			global_sourcemgr = compilation->getSourceManager();
+				if (driver.diagEngine.getNumErrors()) {
+					// Stop here should there have been any errors from AST compilation,
+					// PopulateNetlist requires a well-formed AST without error nodes
+					(void) driver.reportDiagnostics(/* quiet */ false);
+					if (!in_succesful_failtest)
+						log_error("Compilation failed\n");
+					return;
+				}
 
-			HierarchyQueue hqueue;
-			for (auto instance : compilation->getRoot().topInstances) {
-				if (instance->getDefinition().definitionKind == ast::DefinitionKind::Program) {
-					slang::Diagnostic program_diag(diag::ProgramUnsupported, instance->location);
-					driver.diagEngine.issue(program_diag);
+				if (settings.ast_compilation_only.value_or(false)) {
+					(void) driver.reportDiagnostics(/* quiet */ false);
 					continue;
 				}
 
-				auto ref_body = &get_instance_body(settings, *instance);
-				log_assert(ref_body->parentInstance);
-				auto [netlist, new_] = hqueue.get_or_emplace(ref_body, design, settings,
-															 *compilation, *ref_body->parentInstance);
-				log_assert(new_);
-				netlist.canvas->attributes[ID::top] = 1;
-			}
+				global_compilation = &(*compilation);
+				global_sourcemgr = compilation->getSourceManager();
+
+				if (settings.hierarchy_mode() == SynthesisSettings::AUTO)
+					estimate_replication(settings, compilation->getRoot());
+
+				// In lint-only mode we populate a scratch design which gets discarded,
+				// with --emit the modules in the scratch design get written out as
+				// they are finished; sweep points get populated into a scratch design
+				// before their modules get renamed and moved into `design`
+				RTLIL::Design scratch;
+				RTLIL::Design *target = settings.lint_only.value_or(false) || emit_file.is_open()
+											|| !point.empty() ? &scratch : design;
+				std::vector<RTLIL::IdString> point_module_names;
+				// in lint-only mode, the size of the modules we have stripped
+				int lint_wires = 0, lint_cells = 0;
+
+				HierarchyQueue hqueue;
+				for (auto instance : compilation->getRoot().topInstances) {
+					if (instance->getDefinition().definitionKind == ast::DefinitionKind::Program) {
+						slang::Diagnostic program_diag(diag::ProgramUnsupported, instance->location);
+						driver.diagEngine.issue(program_diag);
+						continue;
+					}
 
-			for (int i = 0; i < (int) hqueue.queue.size(); i++) {
-				NetlistContext &netlist = *hqueue.queue[i];
-				emitted_module_names.push_back(netlist.canvas->name);
+					auto ref_body = &get_instance_body(settings, *instance);
+					log_assert(ref_body->parentInstance);
+					auto [netlist, new_] = hqueue.get_or_emplace(ref_body, target, settings,
+																 *compilation, *ref_body->parentInstance);
+					log_assert(new_);
+					netlist.canvas->attributes[ID::top] = 1;
+				}
 
-				if (netlist.disabled)
-					continue;
+				for (int i = 0; i < (int) hqueue.queue.size(); i++) {
+					NetlistContext &netlist = *hqueue.queue[i];
+					point_module_names.push_back(netlist.canvas->name);
 
-				PopulateNetlist populate(hqueue, netlist);
-				netlist.realm.visit(populate);
+					if (netlist.disabled)
+						continue;
+
+					PopulateNetlist populate(hqueue, netlist);
+					netlist.realm.visit(populate);
+
+					slang::Diagnostics diags;
+					diags.append_range(populate.mem_detect.issued_diagnostics);
+					diags.append_range(netlist.issued_diagnostics);
+					diags.sort(driver.sourceManager);
+
+					if (check_diagnostics(driver.diagEngine, diags, /*last=*/false))
+						in_succesful_failtest = true;
+
+					for (int i = 0; i < (int) diags.size(); i++) {
+						if (i > 0 && diags[i] == diags[i - 1])
+							continue;
+						driver.diagEngine.issue(diags[i]);
+					}
+
+					netlist.finalize();
+					if (emit_file.is_open())
+						emit_module(emit_file, settings, netlist.canvas);
+					if (settings.lint_only.value_or(false)) {
+						lint_wires += GetSize(netlist.canvas->wires());
+						lint_cells += GetSize(netlist.canvas->cells());
+						strip_module(netlist.canvas);
+					}
 
-				slang::Diagnostics diags;
-				diags.append_range(populate.mem_detect.issued_diagnostics);
-				diags.append_range(netlist.issued_diagnostics);
-				diags.sort(driver.sourceManager);
+					if (settings.max_netlist_errors.has_value() &&
+							(int) driver.diagEngine.getNumErrors() >= settings.max_netlist_errors.value()) {
+						log("Reached the limit of %d errors, skipping import of the %d remaining modules.\n",
+							settings.max_netlist_errors.value(), (int) hqueue.queue.size() - i - 1);
+						break;
+					}
+				}
 
-				if (check_diagnostics(driver.diagEngine, diags, /*last=*/false))
+				if (check_diagnostics(driver.diagEngine, {}, /*last=*/true))
 					in_succesful_failtest = true;
 
-				for (int i = 0; i < (int) diags.size(); i++) {
-					if (i > 0 && diags[i] == diags[i - 1])
-						continue;
-					driver.diagEngine.issue(diags[i]);
+				if (!driver.reportDiagnostics(/* quiet */ false)) {
+					if (!in_succesful_failtest)
+						log_error("Compilation failed\n");
+					return;
+				}
+
+				if (settings.lint_only.value_or(false)) {
+					// blackboxes exported while importing weren't stripped
+					Yosys::pool<RTLIL::IdString> stripped(point_module_names.begin(),
+														  point_module_names.end());
+					for (auto mod : scratch.modules()) {
+						if (stripped.count(mod->name))
+							continue;
+						lint_wires += GetSize(mod->wires());
+						lint_cells += GetSize(mod->cells());
+					}
+					log("Lint only: imported %d modules with %d wires and %d cells, discarding them.\n",
+						GetSize(scratch.modules()), lint_wires, lint_cells);
+					continue;
+				}
+
+				if (emit_file.is_open()) {
+					// blackboxes exported while importing
+					Yosys::pool<RTLIL::IdString> emitted(point_module_names.begin(),
+														 point_module_names.end());
+					for (auto mod : scratch.modules()) {
+						if (!emitted.count(mod->name))
+							RTLIL_BACKEND::dump_module(emit_file, "", mod, &scratch, false);
+					}
+					emit_file << "autoidx " << Yosys::autoidx << "\n";
+					log("Wrote %d modules to `%s'.\n", GetSize(scratch.modules()),
+						settings.emit.value().c_str());
+					continue;
 				}
+
+				if (!point.empty())
+					point_module_names = move_sweep_point(scratch, design, point_module_names, point);
+				emitted_module_names.insert(emitted_module_names.end(),
+						point_module_names.begin(), point_module_names.end());
 			}
 
-			if (check_diagnostics(driver.diagEngine, {}, /*last=*/true))
-				in_succesful_failtest = true;
+			if (settings.blame)
+				blame.write(settings.blame_report.value());
 
-			if (!driver.reportDiagnostics(/* quiet */ false)) {
-				if (!in_succesful_failtest)
-					log_error("Compilation failed\n");
+			if (settings.lint_only.value_or(false) || settings.ast_compilation_only.value_or(false)
+					|| emit_file.is_open())
 				return;
-			}
+
+			if (settings.module_dedup.value_or(false))
+				dedup_modules(design, emitted_module_names);
 		} catch (const std::exception& e) {
 			log_error("Exception: %s\n", e.what());
 		}
 
-		if (!settings.no_proc.value_or(false)) {
-			// Hack to get an empty selection in a way compatible with both pre and post Yosys v0.52
-			// Front of the selection stack should be a "full selection" at any time, and we can
-			// amend it.
-			RTLIL::Selection emitted_modules = design->selection_stack.front();
-			emitted_modules.full_selection = false;
-			for (auto name : emitted_module_names)
-				emitted_modules.selected_modules.insert(name);
-
-			design->selection_stack.push_back(emitted_modules);
-
-			log_push();
-			call(design, "undriven");
-			call(design, "proc_clean");
-			call(design, "tribuf");
-			call(design, "proc_rmdead");
-			call(design, "proc_prune");
-			call(design, "proc_init");
-			call(design, "proc_rom");
-			call(design, "proc_mux");
-			call(design, "proc_clean");
-			call(design, "opt_expr -keepdc");
-			log_pop();
+		if (!settings.no_proc.value_or(false))
+			lower_processes(design, settings, emitted_module_names);
+	}
 
+	// Runs the post-import passes on the given modules
+	void lower_processes(RTLIL::Design *design, SynthesisSettings &settings,
+						 const std::vector<RTLIL::IdString> &modules)
+	{
+		// Hack to get an empty selection in a way compatible with both pre and post Yosys v0.52
+		// Front of the selection stack should be a "full selection" at any time, and we can
+		// amend it.
+		RTLIL::Selection emitted_modules = design->selection_stack.front();
+		emitted_modules.full_selection = false;
+		RTLIL::Selection proc_modules = emitted_modules, tribuf_modules = emitted_modules;
+		for (auto name : modules)
+			emitted_modules.selected_modules.insert(name);
+
+		log_push();
+		log_header(design, "Executing UNDRIVEN pass. (resolve undriven signals)\n");
+		for (auto name : modules) {
+			RTLIL::Module *mod = design->module(name);
+			if (!mod)
+				continue;
+			// Modules renamed after import (e.g. sweep points) have no recorded
+			// features; they get scanned in full and go through all of the passes
+			auto it = settings.module_features.find(name);
+			if (it != settings.module_features.end()) {
+				std::vector<RTLIL::Wire *> wires;
+				for (auto wire_name : it->second.init_wires) {
+					if (RTLIL::Wire *wire = mod->wire(wire_name))
+						wires.push_back(wire);
+				}
+				resolve_undriven(mod, wires);
+			} else {
+				resolve_undriven(mod, collect_init_wires(mod));
+			}
+
+			if (!mod->processes.empty())
+				proc_modules.selected_modules.insert(name);
+			if (it == settings.module_features.end() || it->second.has_z)
+				tribuf_modules.selected_modules.insert(name);
+		}
+
+		// Runs the pass only on the selected modules, if there are any
+		auto run_on = [&](const RTLIL::Selection &selection, std::string command) {
+			if (selection.selected_modules.empty())
+				return;
+			design->selection_stack.push_back(selection);
+			call(design, command);
 			design->selection_stack.pop_back();
+		};
+
+		run_on(proc_modules, "proc_clean");
+		run_on(tribuf_modules, "tribuf");
+		run_on(proc_modules, "proc_rmdead");
+		run_on(proc_modules, "proc_prune");
+		run_on(proc_modules, "proc_init");
+		run_on(proc_modules, "proc_rom");
+		run_on(proc_modules, "proc_mux");
+		run_on(proc_modules, "proc_clean");
+		run_on(emitted_modules, "opt_expr -keepdc");
+		log_pop();
+	}
+
+	// For `--emit`: lowers the processes of a finished module, writes it out
+	// and drops its contents
+	void emit_module(std::ostream &f, SynthesisSettings &settings, RTLIL::Module *mod)
+	{
+		if (!settings.no_proc.value_or(false))
+			lower_processes(mod->design, settings, {mod->name});
+		RTLIL_BACKEND::dump_module(f, "", mod, mod->design, false);
+		// let downstream consumers of the stream pick up the module right away
+		f.flush();
+		strip_module(mod);
+	}
+
+	// Drops the contents of a finished module. Port wires stay as parents
+	// instantiating the same body later look them up.
+	static void strip_module(RTLIL::Module *mod)
+	{
+		for (auto cell : mod->cells().to_vector())
+			mod->remove(cell);
+		for (auto &[id, proc] : mod->processes)
+			delete proc;
+		mod->processes.clear();
+		for (auto &[id, mem] : mod->memories)
+			delete mem;
+		mod->memories.clear();
+		mod->new_connections({});
+
+		Yosys::pool<RTLIL::Wire *> internal;
+		for (auto wire : mod->wires()) {
+			if (!wire->port_id)
+				internal.insert(wire);
 		}
+		mod->remove(internal);
 	}
 } SlangFrontend;
 
@@ -3271,46 +4478,8 @@ struct UndrivenPass : Pass {
 		}
 		extra_args(args, argidx, d);
 
-		for (auto module : d->selected_whole_modules_warn()) {
-			SigPool driven;
-
-			std::function<void(RTLIL::CaseRule *rule)> visit_case = [&](RTLIL::CaseRule *rule) {
-				for (auto &action : rule->actions)
-					driven.add(action.first);
-
-				for (auto switch_ : rule->switches) {
-					for (auto case_ : switch_->cases)
-						visit_case(case_);
-				}
-			};
-
-			for (auto proc : module->processes) {
-				visit_case(&proc.second->root_case);
-
-				if (!proc.second->syncs.empty())
-					log_error("Process %s in module %s contains sync rules, that's unsupported by the 'undriven' command.\n",
-							  log_id(proc.second), log_id(module));
-			}
-
-			for (auto conn : module->connections())
-				driven.add(conn.first);
-
-			for (auto cell : module->cells())
-			for (auto &conn : cell->connections())
-			if (cell->output(conn.first))
-			for (auto bit : conn.second)
-				driven.add(bit);
-
-			for (auto wire : module->wires()) {
-				if (!wire->attributes.count(ID::init) || wire->port_input)
-					continue;
-
-				Const &init = wire->attributes[ID::init];
-				for (int i = 0; i < wire->width; i++)
-				if (!driven.check(SigBit(wire, i)) && i < init.size() && (init[i] == RTLIL::S1 || init[i] == RTLIL::S0))
-					module->connect(SigBit(wire, i), init[i]);
-			}
-		}
+		for (auto module : d->selected_whole_modules_warn())
+			resolve_undriven(module, collect_init_wires(module));
 	}
 } UndrivenPass;
 
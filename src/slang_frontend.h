@@ -85,7 +85,7 @@ public:
 		Invalid
 	} kind;
 
-	static Variable from_symbol(const ast::ValueSymbol *symbol, int depth=-1);
+	static Variable from_symbol(const ast::ValueSymbol *symbol, int depth=-1, int rank=-1);
 	static Variable escape_flag(int id);
 	static Variable dummy(int width);
 
@@ -112,7 +112,11 @@ private:
 	};
 	int depth = 0;
 
-	Variable(enum Kind kind, const ast::ValueSymbol *symbol, int depth);
+	// Position of `symbol` in the canonical variable order if known (as assigned
+	// by `rank_symbols`), or -1. Lets us skip the scope walk in `operator<`.
+	int rank = -1;
+
+	Variable(enum Kind kind, const ast::ValueSymbol *symbol, int depth, int rank);
 	Variable(enum Kind kind, const ast::Statement *statement, int depth);
 	Variable(enum Kind kind, int width);
 
@@ -139,6 +143,14 @@ struct EvalContext {
 	VariableBits streaming_lhs(ast::StreamingConcatenationExpression const &expr);
 	RTLIL::SigSpec streaming(ast::StreamingConcatenationExpression const &expr);
 
+	// Cheap conservative check whether slang's constant evaluation of the
+	// expression can possibly succeed. Constant evaluation fails on any
+	// expression which strictly depends on a variable or net, which
+	// covers most of a datapath; skipping it there saves re-evaluating
+	// the same subtrees at every level of a deep expression.
+	bool may_fold(ast::Expression const &expr);
+	Yosys::dict<const ast::Expression *, bool> may_fold_cache;
+
 	// Evaluates the given symbols/expressions to their value in this context
 	RTLIL::SigSpec operator()(ast::Expression const &expr);
 	RTLIL::SigSpec operator()(ast::Symbol const &symbol);
@@ -147,6 +159,17 @@ struct EvalContext {
 	// be so that the result can always be interpreted as a signed value
 	RTLIL::SigSpec eval_signed(ast::Expression const &expr);
 
+	// Computes the address into an inferred memory for a word select as
+	// recognized by `NetlistContext::memory_word_select`; if `valid` is given
+	// it's set to a signal which is high if all of the indices are in range
+	RTLIL::SigSpec memory_address(ast::ElementSelectExpression const &sel,
+			RTLIL::SigSpec *valid = nullptr);
+
+	// If `sel` reads a word from a constant array at least as large as the
+	// ROM threshold, emits the read from a ROM holding the array and returns
+	// the read data
+	std::optional<RTLIL::SigSpec> rom_read(ast::ElementSelectExpression const &sel);
+
 	// Describes the given LHS expression in terms of `VariableBits`, if possible.
 	//
 	// This doesn't handle dynamic addressing and streaming expressions,
@@ -225,6 +248,18 @@ private:
 	Yosys::dict<Variable, slang::SourceLocation> seen_nonblocking_assignment;
 	std::vector<RTLIL::Cell *> preceding_memwr;
 
+	// Run of consecutive masked assignments to the same bits which we have
+	// yet to lower, all of it represented to readers by the `result` wire
+	struct MaskedWriteChain {
+		VariableBits lvalue;
+		RTLIL::SigSpec background;
+		// pairs of (unmasked rvalue, mask) in order of assignment
+		std::vector<std::pair<RTLIL::SigSpec, RTLIL::SigSpec>> writes;
+		RTLIL::Wire *result;
+	};
+	std::vector<MaskedWriteChain> masked_writes;
+	void emit_masked_writes();
+
 public:
 	ProceduralContext(NetlistContext &netlist, ProcessTiming &timing);
 	~ProceduralContext();
@@ -233,6 +268,9 @@ public:
 	// ProceduralContext without inheriting the ProcessTiming
 	void inherit_state(ProceduralContext &other);
 	void copy_case_tree_into(RTLIL::CaseRule &rule);
+	// Drop the merging of branch values for `bits` from the case tree, for
+	// when the caller takes the final values of those bits from elsewhere
+	void drop_merge_path(const Yosys::pool<VariableBit> &bits);
 	VariableBits all_driven();
 
 	// Return an enable signal for the current case node
@@ -240,6 +278,7 @@ public:
 
 	// For $check, $print cells
 	void set_effects_trigger(RTLIL::Cell *cell);
+	// An empty `mask` stands for all ones
 	void update_variable_state(slang::SourceLocation loc, VariableBits lvalue, RTLIL::SigSpec unmasked_rvalue, RTLIL::SigSpec mask, bool blocking);
 	void do_simple_assign(slang::SourceLocation loc, VariableBits lvalue, RTLIL::SigSpec rvalue, bool blocking);
 	RTLIL::SigSpec substitute_rvalue(VariableBits bits);
@@ -281,6 +320,15 @@ public:
 		Map visible_assignments;
 		Map revert;
 
+		// Result wire of the masked write chain open for extension, if any.
+		// We clear this once the wire is observed or overwritten, or the state
+		// is saved or restored, at which point the chain can no longer grow.
+		RTLIL::Wire *open_chain = nullptr;
+
+		// Bits of the wires merging the branch values of a variable at the
+		// end of a switch, mapped to the variable bit they hold
+		Yosys::dict<RTLIL::SigBit, VariableBit> merge_wires;
+
 		void set(VariableBits lhs, RTLIL::SigSpec value);
 		RTLIL::SigSpec evaluate(NetlistContext &netlist, VariableBits vbits);
 		RTLIL::SigSpec evaluate(NetlistContext &netlist, VariableChunk vchunk);
@@ -357,16 +405,19 @@ struct RTLILBuilder {
 		}
 	}
 	SigSpec CountOnes(SigSpec sig, int result_width);
-
-	void add_dual_edge_aldff(const std::string &base_name, RTLIL::SigSpec clk,
-							 RTLIL::SigSpec aload, RTLIL::SigSpec d, RTLIL::SigSpec q,
-							 RTLIL::SigSpec ad, bool aload_polarity);
-	void add_dff(RTLIL::IdString name, const RTLIL::SigSpec &clk, const RTLIL::SigSpec &d,
+	// $onehot, or $onehot0 if `zero_allowed`
+	SigSpec OneHot(SigSpec sig, bool zero_allowed);
+
+	// returns the posedge and negedge flop
+	std::pair<RTLIL::Cell *, RTLIL::Cell *> add_dual_edge_aldff(const std::string &base_name,
+							 RTLIL::SigSpec clk, RTLIL::SigSpec aload, RTLIL::SigSpec d,
+							 RTLIL::SigSpec q, RTLIL::SigSpec ad, bool aload_polarity);
+	RTLIL::Cell *add_dff(RTLIL::IdString name, const RTLIL::SigSpec &clk, const RTLIL::SigSpec &d,
 				 const RTLIL::SigSpec &q, bool clk_polarity=true);
-	void add_dffe(RTLIL::IdString name, const RTLIL::SigSpec &clk, const RTLIL::SigSpec &en,
+	RTLIL::Cell *add_dffe(RTLIL::IdString name, const RTLIL::SigSpec &clk, const RTLIL::SigSpec &en,
 				 const RTLIL::SigSpec &d, const RTLIL::SigSpec &q, bool clk_polarity=true,
 				 bool en_polarity=true);
-	void add_aldff(RTLIL::IdString name, const RTLIL::SigSpec &clk, const RTLIL::SigSpec &aload,
+	RTLIL::Cell *add_aldff(RTLIL::IdString name, const RTLIL::SigSpec &clk, const RTLIL::SigSpec &aload,
 				   const RTLIL::SigSpec &d, const RTLIL::SigSpec &q, const RTLIL::SigSpec &ad, 
 				   bool clk_polarity = true, bool aload_polarity = true);
 
@@ -414,12 +465,14 @@ public:
 	std::vector<Diagnostic> issued_diagnostics;
 };
 
+struct BlameReport;
 struct SynthesisSettings {
 	std::optional<bool> dump_ast;
 	std::optional<bool> no_proc;
 	std::optional<bool> compat_mode;
 	std::optional<bool> keep_hierarchy;
 	std::optional<bool> best_effort_hierarchy;
+	std::optional<int64_t> auto_hierarchy;
 	std::optional<bool> ignore_timing;
 	std::optional<bool> ignore_initial;
 	std::optional<bool> ignore_assertions;
@@ -428,16 +481,43 @@ struct SynthesisSettings {
 	std::optional<bool> no_implicit_memories;
 	std::optional<bool> empty_blackboxes;
 	std::optional<bool> ast_compilation_only;
+	std::optional<bool> lint_only;
+	std::optional<int> max_netlist_errors;
+	std::optional<std::string> sweep;
+	std::optional<std::string> blame_report;
+	std::optional<std::string> emit;
 	std::optional<bool> no_default_translate_off;
 	std::optional<bool> allow_dual_edge_ff;
 	std::optional<bool> no_synthesis_define;
+	std::optional<bool> no_split_flops;
+	std::optional<bool> module_dedup;
+	std::optional<bool> no_netlist_check;
+	std::optional<bool> gate_netlist;
+	std::optional<int> rom_threshold_;
 	// pass std::less<> to enable transparent lookup
 	std::set<std::string, std::less<>> blackboxed_modules;
 	bool disable_instance_caching = false;
 
+	// In the AUTO hierarchy mode: for each module definition, the number of
+	// its instances times the estimated size of one, see `estimate_replication`
+	Yosys::dict<const ast::DefinitionSymbol *, int64_t> replication_weight;
+
+	// Where imported modules get accounted for `--blame-report`, if requested
+	BlameReport *blame = nullptr;
+
+	// What the post-import passes need to know about an imported module:
+	// the wires which were given an `init` attribute, and whether any
+	// high-impedance constants were emitted (which `tribuf` looks for)
+	struct ModuleFeatures {
+		std::vector<RTLIL::IdString> init_wires;
+		bool has_z = false;
+	};
+	Yosys::dict<RTLIL::IdString, ModuleFeatures> module_features;
+
 	enum HierMode {
 		NONE,
 		BEST_EFFORT,
+		AUTO,
 		ALL
 	};
 
@@ -445,6 +525,8 @@ struct SynthesisSettings {
 	{
 		if (keep_hierarchy.value_or(false))
 			return ALL;
+		if (auto_hierarchy.has_value())
+			return AUTO;
 		if (best_effort_hierarchy.value_or(false))
 			return BEST_EFFORT;
 		return NONE;
@@ -454,6 +536,10 @@ struct SynthesisSettings {
 		return unroll_limit_.value_or(4000);
 	}
 
+	int rom_threshold() {
+		return rom_threshold_.value_or(1024);
+	}
+
 	void addOptions(slang::CommandLine &cmdLine);
 };
 
@@ -487,16 +573,29 @@ struct NetlistContext : RTLILBuilder, public DiagnosticIssuer {
 	};
 	Yosys::dict<RTLIL::IdString, Memory> emitted_mems;
 
+	// ROMs emitted for lookups into constant arrays held in parameters
+	Yosys::dict<const ast::Symbol *, RTLIL::IdString> emitted_roms;
+
 	// Used to implement modports on `realm`
 	Yosys::dict<const ast::Scope*, std::string YS_HASH_PTR_OPS> scopes_remap;
 
 	// Cache per-symbol Wire* pointers
 	Yosys::dict<const ast::Symbol*, RTLIL::Wire *> wire_cache;
 
+	// Dense ranks of the variables declared in this netlist, see `rank_symbols`
+	Yosys::dict<const ast::Symbol*, int> variable_ranks;
+
+	// Delay lines built for `$past`, keyed on the clock, its polarity and the
+	// delayed signal; the i-th entry is the signal delayed by i+1 cycles
+	Yosys::dict<std::tuple<RTLIL::SigBit, bool, RTLIL::SigSpec>, std::vector<RTLIL::SigSpec>> past_chains;
+
 	// Flag to disable elaboration; we set this when `scopes_remap` is
 	// incomplete due to prior errors
 	bool disabled = false;
 
+	// Set once a constant with `z` bits has been converted for this module
+	bool emitted_z = false;
+
 	NetlistContext(RTLIL::Design *design,
 		SynthesisSettings &settings,
 		ast::Compilation &compilation,
@@ -507,12 +606,24 @@ struct NetlistContext : RTLILBuilder, public DiagnosticIssuer {
 
 	~NetlistContext();
 
+	// Finishes up the module once it has been populated, and drops the
+	// frontend-side tables we no longer need to lower peak memory. Port wires
+	// stay in the wire cache as parents instantiating the module look them up.
+	void finalize();
+	bool finalized = false;
+
 	NetlistContext(const NetlistContext&) = delete;
 	NetlistContext& operator=(const NetlistContext&) = delete;
 
 	Yosys::pool<const ast::Symbol *> detected_memories;
+	// Number of leading unpacked dimensions folded into the address of each
+	// of the detected memories
+	Yosys::dict<const ast::Symbol *, int> memory_dimensions;
 	bool is_inferred_memory(const ast::Symbol &symbol);
-	bool is_inferred_memory(const ast::Expression &expr);
+
+	// If `sel` selects a full word of an inferred memory, returns the memory;
+	// on multi-dimensional memories this takes a chain of selects
+	const ast::ValueSymbol *memory_word_select(const ast::ElementSelectExpression &sel);
 
 	bool is_blackbox(const ast::DefinitionSymbol &sym, slang::Diagnostic *why_blackbox=nullptr);
 	bool should_dissolve(const ast::InstanceSymbol &sym, slang::Diagnostic *why_not_dissolved=nullptr);
@@ -537,6 +648,25 @@ extern void import_blackboxes_from_rtlil(slang::SourceManager &mgr, ast::Compila
 extern bool is_decl_empty_module(const slang::syntax::SyntaxNode &syntax);
 extern void export_blackbox_to_rtlil(NetlistContext &netlist, const ast::InstanceSymbol &inst, RTLIL::Design *target);
 
+// blame.cc
+struct BlameReport {
+	struct Stats {
+		int64_t cells = 0;
+		int64_t cell_bits = 0;
+		int64_t wires = 0;
+		int64_t wire_bits = 0;
+	};
+
+	// keyed on the `src` attribute and on the module name respectively
+	Yosys::dict<std::string, Stats> by_source;
+	Yosys::dict<std::string, Stats> by_module;
+
+	void account(RTLIL::Module *mod, std::string_view module_name);
+	// Writes the report sorted from the largest contributor, as JSON if
+	// the filename ends in `.json`, as text otherwise
+	void write(const std::string &filename);
+};
+
 // abort_helpers.cc
 [[noreturn]] void unimplemented_(const ast::Symbol &obj, const char *file, int line, const char *condition);
 [[noreturn]] void unimplemented_(const ast::Expression &obj, const char *file, int line, const char *condition);
@@ -550,6 +680,10 @@ extern void export_blackbox_to_rtlil(NetlistContext &netlist, const ast::Instanc
 [[noreturn]] void wire_missing_(NetlistContext &netlist, const ast::Symbol &symbol, const char *file, int line);
 #define wire_missing(netlist, symbol) { wire_missing_(netlist, symbol, __FILE__, __LINE__); }
 
+// variables.cc
+// Assign dense ranks to the given symbols which agree with the ordering of `Variable`
+Yosys::dict<const ast::Symbol*, int> rank_symbols(std::vector<const ast::ValueSymbol *> symbols);
+
 // naming.cc
 typedef std::pair<VariableChunk, std::string> NamedChunk;
 std::vector<NamedChunk> generate_subfield_names(VariableChunk chunk, const ast::Type *type);
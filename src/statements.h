@@ -138,6 +138,8 @@ public:
 					transfer_attrs(netlist, *sw->statement, w);
 				parent->aux_actions.push_back(RTLIL::SigSig(w, w_default));
 				vstate.set(chunk, w);
+				for (int i = 0; i < chunk.bitwidth(); i++)
+					vstate.merge_wires.insert({RTLIL::SigBit(w, i), chunk[i]});
 			}
 
 			for (auto &branch : branch_updates) {
@@ -494,6 +496,207 @@ public:
 		context.current_case = context.current_case->add_switch({})->add_case({});
 	}
 
+	// Decide whether we can lower the loop with each unrolled iteration in a switch
+	// of its own (see `handle_flat_loop`), rather than nesting each iteration
+	// in the switch of the preceding one. For this the trip count needs to be
+	// decided by variables private to the loop, so that by executing the steps
+	// unconditionally we keep those variables constant.
+	static bool flat_lowerable(const ast::ForLoopStatement &stmt)
+	{
+		if (stmt.loopVars.empty())
+			return false;
+
+		Yosys::pool<const ast::Symbol *> loop_vars;
+		for (auto var : stmt.loopVars)
+			loop_vars.insert(var);
+
+		Yosys::pool<const ast::Symbol *> assigned;
+		bool opaque = false;
+		auto lhs_visitor = ast::makeVisitor([&](auto &, const ast::ValueExpressionBase &expr) {
+			assigned.insert(&expr.symbol);
+		});
+		auto visitor = ast::makeVisitor(
+				[&](auto &visitor, const ast::AssignmentExpression &assign) {
+					assign.left().visit(lhs_visitor);
+					visitor.visitDefault(assign);
+				},
+				[&](auto &visitor, const ast::UnaryExpression &unop) {
+					using UnOp = ast::UnaryOperator;
+					if (unop.op == UnOp::Postincrement || unop.op == UnOp::Preincrement ||
+							unop.op == UnOp::Postdecrement || unop.op == UnOp::Predecrement)
+						unop.operand().visit(lhs_visitor);
+					visitor.visitDefault(unop);
+				},
+				[&](auto &visitor, const ast::CallExpression &call) {
+					if (!call.isSystemCall())
+						opaque = true;
+					visitor.visitDefault(call);
+				});
+
+		// The stop condition and the steps get evaluated even after we break
+		// out, so they must not have any effects outside the loop variables
+		stmt.stopExpr->visit(visitor);
+		for (auto step : stmt.steps)
+			step->visit(visitor);
+		if (opaque)
+			return false;
+		for (auto sym : assigned)
+			if (!loop_vars.count(sym))
+				return false;
+
+		assigned.clear();
+		stmt.body.visit(visitor);
+		for (auto sym : loop_vars)
+			if (assigned.count(sym))
+				return false;
+
+		return true;
+	}
+
+	// Lower a loop accepted by `flat_lowerable`. Iterations which are not known
+	// to run get switches of their own, siblings in the case we start from, with
+	// their enables derived from the stop conditions in one go once the loop is
+	// unrolled. An iteration picks up the variable state left by the preceding
+	// one, which is sound since it can only run if the preceding one did, and
+	// after the loop we select the final state among those left by the
+	// iterations in a single $pmux.
+	void handle_flat_loop(const ast::ForLoopStatement &stmt, const Variable &flag)
+	{
+		using VariableState = ProceduralContext::VariableState;
+
+		// set once we get to the first iteration which is not known to run
+		Case *parent = nullptr;
+		VariableState::Map loop_save;
+		// the stop condition ahead of each iteration with a switch, and the
+		// switch signal
+		RTLIL::SigSpec stops, enables;
+		// variable updates made by each iteration with a switch
+		std::vector<std::pair<VariableBits, RTLIL::SigSpec>> updates;
+
+		unroll_limit.enter_unrolling();
+		while (true) {
+			RTLIL::SigSpec cv = netlist.ReduceBool(eval(*stmt.stopExpr));
+			RTLIL::SigSpec stop = netlist.LogicOr(netlist.LogicNot(cv),
+												  context.substitute_rvalue(flag));
+
+			if (stop.is_fully_const() && stop.as_bool())
+				break;
+
+			if (!parent && stop.is_fully_const()) {
+				RegisterEscapeConstructGuard guard2(context, EscapeConstructKind::LoopBody, &stmt);
+				stmt.body.visit(*this);
+			} else {
+				if (!parent) {
+					parent = context.current_case;
+					context.vstate.save(loop_save);
+				}
+
+				RTLIL::SigBit enable = netlist.canvas->addWire(netlist.new_id(), 1);
+				stops.append(stop);
+				enables.append(enable);
+
+				Switch *sw = parent->add_switch(enable);
+				sw->statement = &stmt;
+				context.current_case = sw->add_case({RTLIL::S1});
+				context.current_case->statement = &stmt.body;
+
+				VariableState::Map iteration_save;
+				context.vstate.save(iteration_save);
+				// From a semantical POV the following is a no-op, but it allows us to
+				// do more constant folding.
+				context.do_simple_assign(
+						slang::SourceLocation::NoLocation, flag, RTLIL::S0, true);
+				{
+					RegisterEscapeConstructGuard guard2(context, EscapeConstructKind::LoopBody, &stmt);
+					stmt.body.visit(*this);
+				}
+				auto update = context.vstate.restore(iteration_save);
+				context.current_case = parent;
+
+				// Carry the state over into the next iteration, save for variables
+				// which went out of scope
+				VariableBits carried_bits;
+				RTLIL::SigSpec carried_values;
+				for (int i = 0; i < (int)update.first.size(); i++) {
+					VariableBit bit = update.first[i];
+					if (bit.variable.kind != Variable::Static &&
+							!context.vstate.visible_assignments.count(bit))
+						continue;
+					carried_bits.append(bit);
+					carried_values.append(update.second[i]);
+				}
+				context.vstate.set(carried_bits, carried_values);
+				updates.emplace_back(carried_bits, carried_values);
+			}
+
+			for (auto step : stmt.steps)
+				eval(*step);
+
+			if (!unroll_limit.unroll_tick(&stmt))
+				break;
+		}
+		unroll_limit.exit_unrolling();
+
+		if (parent) {
+			// Iteration j runs iff none of the first j+1 stop conditions hold,
+			// take the prefix OR in a logarithmic number of steps
+			RTLIL::SigSpec stopped = stops;
+			for (int d = 1; d < stopped.size(); d *= 2) {
+				RTLIL::SigSpec shifted(RTLIL::S0, d);
+				shifted.append(stopped.extract(0, stopped.size() - d));
+				stopped = netlist.Biop(ID($or), stopped, shifted, false, false, stopped.size());
+			}
+			RTLIL::SigSpec runs = netlist.Not(stopped);
+			netlist.canvas->connect(enables, runs);
+
+			// Iteration j is the last one to run iff it runs and j+1 doesn't
+			RTLIL::SigSpec next_stops = stops.extract(1, stops.size() - 1);
+			next_stops.append(RTLIL::S1);
+			RTLIL::SigSpec last = netlist.Biop(ID($and), runs, next_stops, false, false, runs.size());
+
+			auto region = context.vstate.restore(loop_save);
+
+			// Only the loop variables are assigned outside of the iterations,
+			// those we take as they are
+			Yosys::pool<VariableBit> iterated;
+			for (auto &update : updates)
+				for (auto bit : update.first)
+					iterated.insert(bit);
+
+			VariableBits merged_bits;
+			for (int i = 0; i < (int)region.first.size(); i++) {
+				VariableBit bit = region.first[i];
+				if (!iterated.count(bit))
+					context.vstate.set(bit, region.second[i]);
+				else if (bit.variable.kind == Variable::Static ||
+						context.vstate.visible_assignments.count(bit))
+					merged_bits.append(bit);
+			}
+
+			if (!merged_bits.empty()) {
+				Yosys::dict<VariableBit, int> index;
+				for (int i = 0; i < (int)merged_bits.size(); i++)
+					index[merged_bits[i]] = i;
+
+				RTLIL::SigSpec before = context.vstate.evaluate(netlist, merged_bits);
+				std::vector<RTLIL::SigBit> state = before.to_sigbit_vector();
+				RTLIL::SigSpec candidates;
+				for (auto &[bits, values] : updates) {
+					for (int i = 0; i < (int)bits.size(); i++)
+						if (index.count(bits[i]))
+							state[index.at(bits[i])] = values[i];
+					candidates.append(RTLIL::SigSpec(state));
+				}
+
+				RTLIL::SigSpec merged = netlist.canvas->addWire(netlist.new_id(), before.size());
+				netlist.canvas->addPmux(netlist.new_id(), before, candidates, last, merged);
+				context.vstate.set(merged_bits, merged);
+			}
+		}
+
+		context.current_case = context.current_case->add_switch({})->add_case({});
+	}
+
 	void handle(const ast::ForLoopStatement &stmt)
 	{
 		for (auto init : stmt.initializers)
@@ -505,6 +708,10 @@ public:
 		}
 
 		RegisterEscapeConstructGuard guard1(context, EscapeConstructKind::Loop, &stmt);
+		if (flat_lowerable(stmt)) {
+			handle_flat_loop(stmt, guard1.flag);
+			return;
+		}
 
 		std::vector<SwitchHelper> sw_stack;
 		unroll_limit.enter_unrolling();
@@ -14,16 +14,16 @@
 
 namespace slang_frontend {
 
-Variable Variable::from_symbol(const ast::ValueSymbol *symbol, int depth)
+Variable Variable::from_symbol(const ast::ValueSymbol *symbol, int depth, int rank)
 {
 	assert(symbol);
 	if (ast::VariableSymbol::isKind(symbol->kind) &&
 			symbol->as<ast::VariableSymbol>().lifetime == ast::VariableLifetime::Automatic) {
 		assert(depth >= 0);
-		return Variable(Local, symbol, depth);
+		return Variable(Local, symbol, depth, rank);
 	} else {
 		assert(depth == -1);
-		return Variable(Static, symbol, 0);
+		return Variable(Static, symbol, 0, rank);
 	}
 }
 
@@ -46,8 +46,8 @@ Variable Variable::dummy(int width)
 Variable::Variable() : kind(Invalid)
 {}
 
-Variable::Variable(enum Kind kind, const ast::ValueSymbol *symbol, int depth)
-	: kind(kind), symbol(symbol), depth(depth)
+Variable::Variable(enum Kind kind, const ast::ValueSymbol *symbol, int depth, int rank)
+	: kind(kind), symbol(symbol), depth(depth), rank(rank)
 {}
 
 std::vector<const ast::Scope *> scope_path(const ast::Scope *scope, bool stop_at_instance)
@@ -148,17 +148,41 @@ bool order_scopes(const ast::Scope *lhs, const ast::Scope *rhs)
 	return lhs_path.size() < rhs_path.size();
 }
 
+static bool order_value_symbols(const ast::ValueSymbol *lhs, const ast::ValueSymbol *rhs)
+{
+	if (lhs == rhs)
+		return false;
+
+	if (lhs->getParentScope() != rhs->getParentScope())
+		return order_scopes(lhs->getParentScope(), rhs->getParentScope());
+	else
+		return order_symbols_within_scope(lhs, rhs);
+}
+
+Yosys::dict<const ast::Symbol *, int> rank_symbols(std::vector<const ast::ValueSymbol *> symbols)
+{
+	// Pay for the full scope-walking comparison once per netlist, so that
+	// sorting variable bits later on boils down to comparing integers
+	std::sort(symbols.begin(), symbols.end(), order_value_symbols);
+	symbols.erase(std::unique(symbols.begin(), symbols.end()), symbols.end());
+
+	Yosys::dict<const ast::Symbol *, int> ranks;
+	for (int i = 0; i < (int)symbols.size(); i++)
+		ranks[symbols[i]] = i;
+	return ranks;
+}
+
 bool Variable::operator<(const Variable &other) const
 {
 	if (kind != other.kind)
 		return kind < other.kind;
 	if (kind == Local || kind == Static) {
 		if (symbol != other.symbol) {
-			// Find ordering among the symbols
-			if (symbol->getParentScope() != other.symbol->getParentScope())
-				return order_scopes(symbol->getParentScope(), other.symbol->getParentScope());
-			else
-				return order_symbols_within_scope(symbol, other.symbol);
+			// Ranks are consistent with the full ordering below, so it's fine
+			// to mix the two when only one side is ranked
+			if (rank >= 0 && other.rank >= 0)
+				return rank < other.rank;
+			return order_value_symbols(symbol, other.symbol);
 		}
 		return false;
 	} else if (kind == EscapeFlag) {
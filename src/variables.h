@@ -91,6 +91,11 @@ public:
 
 	VariableBits(std::initializer_list<VariableBits> parts)
 	{
+		size_t total = 0;
+		for (auto &part : parts)
+			total += part.size();
+		reserve(total);
+
 		for (auto it = std::rbegin(parts); it != std::rend(parts); it++) {
 			append(*it);
 		}
@@ -70,3 +70,26 @@ module test_bitsel07(data, sel);
 	input signed [4:0] sel;
 	base #(.MSB(-2), .LSB(-7)) t(.*);
 endmodule
+
+module test_bitsel08(logic [7:0] init, logic [11:0] idx, logic [3:0] d);
+	logic [7:0] v1, v2;
+
+	always_comb begin
+		v1 = init;
+		for (int i = 0; i < 4; i++)
+			v1[idx[i*3+:3]] = d[i];
+	end
+
+	always_comb begin
+		v2 = init;
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 8; j++)
+				if (idx[i*3+:3] == j)
+					v2[j] = d[i];
+	end
+
+	always_comb begin
+		if (^{init, idx, d} !== 'x)
+			assert(v1 === v2);
+	end
+endmodule
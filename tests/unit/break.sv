@@ -162,3 +162,35 @@ module test_break10(logic [2:0] span);
 			assert(mask1 === mask2);
 	end
 endmodule
+
+module test_break11(logic [7:0] bits);
+	logic [3:0] ones1, ones2, ones3;
+
+	always_comb begin
+		ones1 = 0;
+		for (int i = 0; i < 8 && bits[i]; i++)
+			ones1++;
+	end
+
+	always_comb begin
+		ones2 = 0;
+		while (ones2 < 8 && bits[ones2])
+			ones2++;
+	end
+
+	always_comb begin
+		ones3 = 0;
+		for (int i = 0; i < 8; i++) begin
+			if (!bits[i])
+				break;
+			ones3++;
+		end
+	end
+
+	always_comb begin
+		if (^bits !== 'x) begin
+			assert(ones1 === ones2);
+			assert(ones3 === ones2);
+		end
+	end
+endmodule
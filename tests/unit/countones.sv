@@ -32,3 +32,38 @@ module countones_constants;
         assert($countones(-4'b111) == 2);
     end
 endmodule // countones_constants
+
+module countones_partconst(input logic [5:0] val);
+    always_comb if (^val !== 'x) begin
+        assert($countones({val[5:3], 3'b101, val[2:0], 2'b00}) ==
+               $countones(val) + 2);
+    end
+endmodule
+
+module onehot_test #(parameter WIDTH = 8) (input logic [WIDTH-1:0] val);
+    function automatic integer reference_count(logic [WIDTH-1:0] v);
+        reference_count = 0;
+        for (int i = 0; i < WIDTH; i++)
+            reference_count += v[i];
+    endfunction
+
+    always_comb if (^val !== 'x) begin
+        assert($onehot(val) == (reference_count(val) == 1));
+        assert($onehot0(val) == (reference_count(val) <= 1));
+        assert($countbits(val, '1) == reference_count(val));
+        assert($countbits(val, '0) == WIDTH - reference_count(val));
+        assert($countbits(val, '0, '1) == WIDTH);
+    end
+endmodule
+
+module onehot_1bit(input logic val);
+    onehot_test #(.WIDTH(1)) t(.val(val));
+endmodule
+
+module onehot_7bit(input logic [6:0] val);
+    onehot_test #(.WIDTH(7)) t(.val(val));
+endmodule
+
+module onehot_16bit(input logic [15:0] val);
+    onehot_test #(.WIDTH(16)) t(.val(val));
+endmodule
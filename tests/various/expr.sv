@@ -157,6 +157,22 @@ end
 // nested streaming
 initial $t(byte_t'({>>3{4'h6, {>>2{4'h7}}}}));
 
+// several operands with a partial last slice
+typedef logic [15:0] half_t;
+initial begin
+	$t(half_t'({<<3{8'hd6, 4'h9, 4'h3}}));
+	$t(half_t'({<<8{8'hd6, 5'h19, 3'h3}}));
+	$t(half_t'({<<5{{<<2{6'h2d}}, 10'h1a5}}));
+end
+
+function [15:0] stream9();
+	logic [4:0] a;
+	logic [10:0] b;
+	{<<3{a, b}} = 16'hd6a5;
+	stream9 = {b, a};
+endfunction
+initial $t(stream9());
+
 function automatic [7:0] f();
     logic [4:0] data[2] = '{12, 43};
 	logic [4:0] a, b;